@@ -0,0 +1,3666 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <system_error>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <functional>
+#include <utility>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
+// Параллельное исполнение для длинных чисел: пул потоков с очередью на каждый
+// поток и кражей задач. Владелец берёт задачи с конца своей очереди, остальные
+// крадут с начала. Ожидающий поток не спит, а выполняет чужие задачи, поэтому
+// вложенные fork-join (Карацуба внутри двоичного разбиения) не блокируются.
+// По умолчанию потоков 1 и всё считается последовательно.
+namespace bcd_parallel {
+
+struct ParallelConfig {
+    size_t threads = 1;
+    // Ниже этих порогов работа не делится: длина меньшего множителя в лимбах
+    // и число членов ряда на отрезке двоичного разбиения
+    size_t min_limbs = 2000;
+    long long min_terms = 4096;
+};
+
+inline ParallelConfig parallel_config;
+
+class WorkStealingPool {
+public:
+    struct Task {
+        std::function<void()> fn;
+        std::atomic<bool> done{false};
+        std::exception_ptr error;
+    };
+    
+    // Вызывающий поток тоже участвует в работе, поэтому рабочих threads - 1
+    explicit WorkStealingPool(size_t threads) : queues(std::max<size_t>(threads, 1)) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+    
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+    
+    size_t size() const {
+        return queues.size();
+    }
+    
+    void submit(Task& task) {
+        Queue& queue = queues[current_index()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(&task);
+        }
+        pending.fetch_add(1);
+        wake.notify_one();
+    }
+    
+    // Ждём задачу, выполняя тем временем другие
+    void wait(Task& task) {
+        while (!task.done.load(std::memory_order_acquire)) {
+            if (!run_one(current_index())) {
+                std::this_thread::yield();
+            }
+        }
+        if (task.error) {
+            std::rethrow_exception(task.error);
+        }
+    }
+    
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+    
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> pending{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    
+    static size_t& worker_index() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+    
+    // Потоки вне пула работают с очередью 0 вместе с вызывающим
+    size_t current_index() const {
+        return worker_index() < queues.size() ? worker_index() : 0;
+    }
+    
+    Task* take(size_t self) {
+        {
+            Queue& own = queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                Task* task = own.tasks.back();
+                own.tasks.pop_back();
+                return task;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue& victim = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                Task* task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return task;
+            }
+        }
+        return nullptr;
+    }
+    
+    bool run_one(size_t self) {
+        Task* task = take(self);
+        if (!task) return false;
+        pending.fetch_sub(1);
+        try {
+            task->fn();
+        } catch (...) {
+            task->error = std::current_exception();
+        }
+        task->done.store(true, std::memory_order_release);
+        return true;
+    }
+    
+    void worker_loop(size_t index) {
+        worker_index() = index;
+        for (;;) {
+            if (run_one(index)) continue;
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            if (stopping) return;
+            wake.wait_for(lock, std::chrono::milliseconds(1), [this] { return stopping || pending.load() > 0; });
+            if (stopping) return;
+        }
+    }
+};
+
+inline std::unique_ptr<WorkStealingPool>& pool_instance() {
+    static std::unique_ptr<WorkStealingPool> instance;
+    return instance;
+}
+
+// Задаёт число потоков; 0 - по числу ядер. Вызывать, когда вычислений нет
+inline void set_threads(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    parallel_config.threads = threads;
+    pool_instance().reset(threads > 1 ? new WorkStealingPool(threads) : nullptr);
+}
+
+inline bool enabled() {
+    return pool_instance() != nullptr;
+}
+
+// Выполняет все функции, параллельно при включённом пуле
+template <typename F, typename... Rest>
+void invoke(F&& first, Rest&&... rest) {
+    if (!enabled()) {
+        first();
+        (rest(), ...);
+        return;
+    }
+    WorkStealingPool& pool = *pool_instance();
+    std::array<WorkStealingPool::Task, sizeof...(Rest)> tasks;
+    size_t i = 0;
+    ((tasks[i++].fn = std::forward<Rest>(rest)), ...);
+    for (WorkStealingPool::Task& task : tasks) {
+        pool.submit(task);
+    }
+    std::exception_ptr error;
+    try {
+        first();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (WorkStealingPool::Task& task : tasks) {
+        try {
+            pool.wait(task);
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// body(from, to) для отрезков [begin, end) длиной не меньше grain
+template <typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F&& body) {
+    size_t count = end - begin;
+    size_t chunks = enabled() ? std::min(pool_instance()->size() * 4, count / std::max<size_t>(grain, 1)) : 1;
+    if (chunks <= 1) {
+        body(begin, end);
+        return;
+    }
+    WorkStealingPool& pool = *pool_instance();
+    std::vector<WorkStealingPool::Task> tasks(chunks - 1);
+    for (size_t c = 1; c < chunks; c++) {
+        size_t from = begin + count * c / chunks;
+        size_t to = begin + count * (c + 1) / chunks;
+        tasks[c - 1].fn = [&body, from, to] { body(from, to); };
+        pool.submit(tasks[c - 1]);
+    }
+    std::exception_ptr error;
+    try {
+        body(begin, begin + count / chunks);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (WorkStealingPool::Task& task : tasks) {
+        try {
+            pool.wait(task);
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace bcd_parallel
+
+// Арифметика над лимбами в системе 10^9 (младший лимб первый).
+// Здесь живут алгоритмы умножения и деления, которыми пользуется BCD.
+namespace bcd_limbs {
+
+constexpr uint32_t BASE = 1000000000;
+constexpr int BASE_DIGITS = 9;
+
+// Память под лимбы. Все буферы Limbs проходят через LimbAllocator, который
+// считает обращения к куче и при включённом пуле (set_pooling) переиспользует
+// освобождённые блоки: у каждого потока свои списки свободных блоков по классам
+// размера 64 * 2^c байт, поэтому блокировок нет. Блок, освобождённый в другом
+// потоке, попадает в пул этого потока. Без пула размер блока точный.
+struct AllocationStats {
+    uint64_t heap_allocations = 0;  // блоков, полученных от operator new
+    uint64_t heap_bytes = 0;
+    uint64_t pool_reuses = 0;       // блоков, взятых из пула потока
+};
+
+namespace detail {
+
+struct AllocationCounters {
+    std::atomic<uint64_t> heap_allocations{0};
+    std::atomic<uint64_t> heap_bytes{0};
+    std::atomic<uint64_t> pool_reuses{0};
+};
+
+inline AllocationCounters allocation_counters;
+inline std::atomic<bool> pooling{false};
+
+constexpr size_t POOL_CLASSES = 26;      // до 2 ГБ; большие блоки идут мимо пула
+constexpr size_t POOL_BLOCKS_PER_CLASS = 16;
+constexpr size_t POOL_MIN_BYTES = 64;
+
+// Тривиально разрушаемое состояние пула живёт до конца потока, поэтому
+// освобождения после разбора пула (из других thread_local) безопасны
+struct PoolState {
+    void* blocks[POOL_CLASSES][POOL_BLOCKS_PER_CLASS];
+    uint32_t count[POOL_CLASSES];
+    bool registered;
+    bool closed;
+};
+
+inline PoolState& pool_state() {
+    static thread_local PoolState state{};
+    return state;
+}
+
+// При завершении потока возвращает накопленные блоки в кучу
+struct PoolDrain {
+    ~PoolDrain() {
+        PoolState& state = pool_state();
+        for (size_t c = 0; c < POOL_CLASSES; c++) {
+            while (state.count[c] > 0) {
+                ::operator delete(state.blocks[c][--state.count[c]]);
+            }
+        }
+        state.closed = true;
+    }
+};
+
+inline size_t size_class(size_t bytes) {
+    size_t c = 0;
+    while ((POOL_MIN_BYTES << c) < bytes) c++;
+    return c;
+}
+
+// Перед каждым блоком - заголовок с его классом размера. Целым классом блок
+// выделяется только при включённом пуле; иначе (и для блоков больше 2 ГБ)
+// размер точный, заголовок хранит EXACT_BLOCK, и в пул такой блок не попадает,
+// даже если пул включили, пока блок был жив
+constexpr size_t BLOCK_HEADER_BYTES = alignof(std::max_align_t);
+constexpr uint32_t EXACT_BLOCK = UINT32_MAX;
+
+inline void* allocate_bytes(size_t bytes) {
+    size_t total = bytes + BLOCK_HEADER_BYTES;
+    uint32_t block_class = EXACT_BLOCK;
+    if (pooling.load(std::memory_order_relaxed)) {
+        size_t c = size_class(total);
+        if (c < POOL_CLASSES) {
+            block_class = static_cast<uint32_t>(c);
+            total = POOL_MIN_BYTES << c;
+            PoolState& state = pool_state();
+            if (state.count[c] > 0) {
+                allocation_counters.pool_reuses.fetch_add(1, std::memory_order_relaxed);
+                return static_cast<char*>(state.blocks[c][--state.count[c]]) + BLOCK_HEADER_BYTES;
+            }
+        }
+    }
+    allocation_counters.heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    allocation_counters.heap_bytes.fetch_add(total, std::memory_order_relaxed);
+    void* block = ::operator new(total);
+    std::memcpy(block, &block_class, sizeof(block_class));
+    return static_cast<char*>(block) + BLOCK_HEADER_BYTES;
+}
+
+inline void deallocate_bytes(void* p, size_t) {
+    void* block = static_cast<char*>(p) - BLOCK_HEADER_BYTES;
+    uint32_t block_class;
+    std::memcpy(&block_class, block, sizeof(block_class));
+    if (block_class != EXACT_BLOCK && pooling.load(std::memory_order_relaxed)) {
+        PoolState& state = pool_state();
+        if (!state.registered) {
+            state.registered = true;
+            static thread_local PoolDrain drain;
+        }
+        if (!state.closed && state.count[block_class] < POOL_BLOCKS_PER_CLASS) {
+            state.blocks[block_class][state.count[block_class]++] = block;
+            return;
+        }
+    }
+    ::operator delete(block);
+}
+
+} // namespace detail
+
+template <typename T>
+struct LimbAllocator {
+    using value_type = T;
+    
+    LimbAllocator() = default;
+    
+    template <typename U>
+    LimbAllocator(const LimbAllocator<U>&) {}
+    
+    T* allocate(size_t n) {
+        return static_cast<T*>(detail::allocate_bytes(n * sizeof(T)));
+    }
+    
+    void deallocate(T* p, size_t n) {
+        detail::deallocate_bytes(p, n * sizeof(T));
+    }
+    
+    template <typename U>
+    bool operator==(const LimbAllocator<U>&) const {
+        return true;
+    }
+    
+    template <typename U>
+    bool operator!=(const LimbAllocator<U>&) const {
+        return false;
+    }
+};
+
+// Включает пулы блоков во всех потоках; выключение не освобождает накопленное
+inline void set_pooling(bool enabled) {
+    detail::pooling.store(enabled);
+}
+
+inline AllocationStats allocation_stats() {
+    AllocationStats stats;
+    stats.heap_allocations = detail::allocation_counters.heap_allocations.load();
+    stats.heap_bytes = detail::allocation_counters.heap_bytes.load();
+    stats.pool_reuses = detail::allocation_counters.pool_reuses.load();
+    return stats;
+}
+
+inline void reset_allocation_stats() {
+    detail::allocation_counters.heap_allocations = 0;
+    detail::allocation_counters.heap_bytes = 0;
+    detail::allocation_counters.pool_reuses = 0;
+}
+
+using Limbs = std::vector<uint32_t, LimbAllocator<uint32_t>>;
+
+// Пороги переключения алгоритмов - длина меньшего множителя в лимбах.
+// Подобраны замером на x86-64 (g++ -O2): Карацуба обгоняет столбик с ~64 лимбов,
+// NTT обгоняет Карацубу с ~1800. В этом диапазоне Тоом-3 проигрывает Карацубе,
+// поэтому он включается только для множителей длиннее NTT_MAX_LENGTH:
+// его пять подпроизведений снова укладываются в NTT.
+struct MulThresholds {
+    size_t karatsuba = 64;
+    size_t toom3 = 1800;
+    size_t ntt = 1800;
+    // Старшая часть произведения (multiply_high) считается укороченным столбиком
+    // ниже этого порога; выше порога Карацубы - только если отбрасывается не меньше
+    // половины столбцов, иначе полный Карацуба быстрее. 0 отключает
+    size_t short_product = 400;
+};
+inline MulThresholds mul_thresholds;
+
+inline void multiply(const uint32_t* a, size_t n, const uint32_t* b, size_t m, uint32_t* out);
+
+inline void trim(Limbs& x) {
+    while (!x.empty() && x.back() == 0) x.pop_back();
+}
+
+inline size_t significant_length(const uint32_t* x, size_t n) {
+    while (n > 0 && x[n - 1] == 0) n--;
+    return n;
+}
+
+// Ядра сложения, вычитания и сравнения лимбов. Перенос в блоке из 32 (AVX2)
+// или 16 (SSE4.2) лимбов находится параллельным префиксом по битовым маскам:
+// лимб порождает перенос, если x + y >= BASE, и пропускает его, если x + y == BASE - 1.
+// Тогда маска входящих переносов C = (P + ((G << 1) | c_in)) ^ P - одно сложение
+// вместо цепочки по лимбам. Реализация выбирается при первом вызове по CPUID.
+struct LimbKernels {
+    // out = x + y (n лимбов), возвращает перенос; out может совпадать с x или y
+    uint32_t (*add_n)(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t carry);
+    // out = x - y (n лимбов), возвращает заём
+    uint32_t (*sub_n)(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t borrow);
+    // Сравнение n лимбов начиная со старшего: -1, 0 или 1
+    int (*compare_n)(const uint32_t* x, const uint32_t* y, size_t n);
+    bool (*is_zero_n)(const uint32_t* x, size_t n);
+    const char* name;
+};
+
+inline uint32_t add_n_scalar(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t carry) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t sum = x[i] + y[i] + carry;
+        carry = sum >= BASE;
+        out[i] = carry ? sum - BASE : sum;
+    }
+    return carry;
+}
+
+inline uint32_t sub_n_scalar(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t borrow) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t sub = y[i] + borrow;
+        borrow = x[i] < sub;
+        out[i] = borrow ? x[i] + BASE - sub : x[i] - sub;
+    }
+    return borrow;
+}
+
+inline int compare_n_scalar(const uint32_t* x, const uint32_t* y, size_t n) {
+    for (size_t i = n; i-- > 0;) {
+        if (x[i] != y[i]) return x[i] < y[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+inline bool is_zero_n_scalar(const uint32_t* x, size_t n) {
+    uint32_t bits = 0;
+    for (size_t i = 0; i < n; i++) bits |= x[i];
+    return bits == 0;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+__attribute__((target("avx2")))
+inline uint32_t add_n_avx2(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t carry) {
+    const __m256i top = _mm256_set1_epi32(BASE - 1);
+    const __m256i base = _mm256_set1_epi32(BASE);
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i sum[4];
+        uint64_t generate = 0, propagate = 0;
+        for (int v = 0; v < 4; v++) {
+            sum[v] = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i + 8 * v)),
+                                      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i + 8 * v)));
+            generate |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(sum[v], top)))) << (8 * v);
+            propagate |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(sum[v], top)))) << (8 * v);
+        }
+        uint64_t carries = (propagate + ((generate << 1) | carry)) ^ propagate;
+        carry = (carries >> 32) & 1;
+        for (int v = 0; v < 4; v++) {
+            __m256i bits = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>((carries >> (8 * v)) & 0xFF)), lane_bits);
+            __m256i result = _mm256_add_epi32(sum[v], _mm256_and_si256(_mm256_cmpeq_epi32(bits, lane_bits), one));
+            result = _mm256_sub_epi32(result, _mm256_and_si256(_mm256_cmpgt_epi32(result, top), base));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 8 * v), result);
+        }
+    }
+    return add_n_scalar(x + i, y + i, out + i, n - i, carry);
+}
+
+__attribute__((target("avx2")))
+inline uint32_t sub_n_avx2(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t borrow) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i base = _mm256_set1_epi32(BASE);
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i diff[4];
+        uint64_t generate = 0, propagate = 0;
+        for (int v = 0; v < 4; v++) {
+            diff[v] = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i + 8 * v)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i + 8 * v)));
+            generate |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(zero, diff[v])))) << (8 * v);
+            propagate |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(diff[v], zero)))) << (8 * v);
+        }
+        uint64_t borrows = (propagate + ((generate << 1) | borrow)) ^ propagate;
+        borrow = (borrows >> 32) & 1;
+        for (int v = 0; v < 4; v++) {
+            __m256i bits = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>((borrows >> (8 * v)) & 0xFF)), lane_bits);
+            __m256i result = _mm256_sub_epi32(diff[v], _mm256_and_si256(_mm256_cmpeq_epi32(bits, lane_bits), one));
+            result = _mm256_add_epi32(result, _mm256_and_si256(_mm256_cmpgt_epi32(zero, result), base));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 8 * v), result);
+        }
+    }
+    return sub_n_scalar(x + i, y + i, out + i, n - i, borrow);
+}
+
+__attribute__((target("avx2")))
+inline int compare_n_avx2(const uint32_t* x, const uint32_t* y, size_t n) {
+    size_t i = n;
+    while (i >= 8) {
+        i -= 8;
+        __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i)));
+        unsigned differ = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(equal))) & 0xFF;
+        if (differ) {
+            size_t lane = i + 31 - __builtin_clz(differ);
+            return x[lane] < y[lane] ? -1 : 1;
+        }
+    }
+    return compare_n_scalar(x, y, i);
+}
+
+__attribute__((target("avx2")))
+inline bool is_zero_n_avx2(const uint32_t* x, size_t n) {
+    __m256i bits = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        bits = _mm256_or_si256(bits, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)));
+    }
+    return _mm256_testz_si256(bits, bits) && is_zero_n_scalar(x + i, n - i);
+}
+
+__attribute__((target("sse4.2")))
+inline uint32_t add_n_sse42(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t carry) {
+    const __m128i top = _mm_set1_epi32(BASE - 1);
+    const __m128i base = _mm_set1_epi32(BASE);
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i one = _mm_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i sum[4];
+        uint32_t generate = 0, propagate = 0;
+        for (int v = 0; v < 4; v++) {
+            sum[v] = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i + 4 * v)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i + 4 * v)));
+            generate |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(sum[v], top)))) << (4 * v);
+            propagate |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(sum[v], top)))) << (4 * v);
+        }
+        uint32_t carries = (propagate + ((generate << 1) | carry)) ^ propagate;
+        carry = (carries >> 16) & 1;
+        for (int v = 0; v < 4; v++) {
+            __m128i bits = _mm_and_si128(_mm_set1_epi32(static_cast<int>((carries >> (4 * v)) & 0xF)), lane_bits);
+            __m128i result = _mm_add_epi32(sum[v], _mm_and_si128(_mm_cmpeq_epi32(bits, lane_bits), one));
+            result = _mm_sub_epi32(result, _mm_and_si128(_mm_cmpgt_epi32(result, top), base));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4 * v), result);
+        }
+    }
+    return add_n_scalar(x + i, y + i, out + i, n - i, carry);
+}
+
+__attribute__((target("sse4.2")))
+inline uint32_t sub_n_sse42(const uint32_t* x, const uint32_t* y, uint32_t* out, size_t n, uint32_t borrow) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i base = _mm_set1_epi32(BASE);
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i one = _mm_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i diff[4];
+        uint32_t generate = 0, propagate = 0;
+        for (int v = 0; v < 4; v++) {
+            diff[v] = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i + 4 * v)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i + 4 * v)));
+            generate |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(zero, diff[v])))) << (4 * v);
+            propagate |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(diff[v], zero)))) << (4 * v);
+        }
+        uint32_t borrows = (propagate + ((generate << 1) | borrow)) ^ propagate;
+        borrow = (borrows >> 16) & 1;
+        for (int v = 0; v < 4; v++) {
+            __m128i bits = _mm_and_si128(_mm_set1_epi32(static_cast<int>((borrows >> (4 * v)) & 0xF)), lane_bits);
+            __m128i result = _mm_sub_epi32(diff[v], _mm_and_si128(_mm_cmpeq_epi32(bits, lane_bits), one));
+            result = _mm_add_epi32(result, _mm_and_si128(_mm_cmpgt_epi32(zero, result), base));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4 * v), result);
+        }
+    }
+    return sub_n_scalar(x + i, y + i, out + i, n - i, borrow);
+}
+
+__attribute__((target("sse4.2")))
+inline int compare_n_sse42(const uint32_t* x, const uint32_t* y, size_t n) {
+    size_t i = n;
+    while (i >= 4) {
+        i -= 4;
+        __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i)));
+        unsigned differ = ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(equal))) & 0xF;
+        if (differ) {
+            size_t lane = i + 31 - __builtin_clz(differ);
+            return x[lane] < y[lane] ? -1 : 1;
+        }
+    }
+    return compare_n_scalar(x, y, i);
+}
+
+__attribute__((target("sse4.2")))
+inline bool is_zero_n_sse42(const uint32_t* x, size_t n) {
+    __m128i bits = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        bits = _mm_or_si128(bits, _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)));
+    }
+    return _mm_testz_si128(bits, bits) && is_zero_n_scalar(x + i, n - i);
+}
+
+#endif
+
+inline LimbKernels select_kernels() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {add_n_avx2, sub_n_avx2, compare_n_avx2, is_zero_n_avx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return {add_n_sse42, sub_n_sse42, compare_n_sse42, is_zero_n_sse42, "sse4.2"};
+    }
+#endif
+    return {add_n_scalar, sub_n_scalar, compare_n_scalar, is_zero_n_scalar, "scalar"};
+}
+
+inline LimbKernels& kernels() {
+    static LimbKernels selected = select_kernels();
+    return selected;
+}
+
+// Прибавление переноса (вычитание заёма) к x с копированием в out
+inline uint32_t add_carry_n(const uint32_t* x, uint32_t* out, size_t n, uint32_t carry) {
+    size_t i = 0;
+    for (; i < n && carry; i++) {
+        carry = x[i] == BASE - 1;
+        out[i] = carry ? 0 : x[i] + 1;
+    }
+    if (out != x) std::copy(x + i, x + n, out + i);
+    return carry;
+}
+
+inline uint32_t sub_borrow_n(const uint32_t* x, uint32_t* out, size_t n, uint32_t borrow) {
+    size_t i = 0;
+    for (; i < n && borrow; i++) {
+        borrow = x[i] == 0;
+        out[i] = borrow ? BASE - 1 : x[i] - 1;
+    }
+    if (out != x) std::copy(x + i, x + n, out + i);
+    return borrow;
+}
+
+// out = 0 - y, возвращает заём
+inline uint32_t negate_n(const uint32_t* y, uint32_t* out, size_t n) {
+    uint32_t borrow = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t sub = y[i] + borrow;
+        borrow = sub != 0;
+        out[i] = borrow ? BASE - sub : 0;
+    }
+    return borrow;
+}
+
+// out += x * BASE^offset; out должен вмещать результат
+inline void add_at(uint32_t* out, size_t out_len, const uint32_t* x, size_t n, size_t offset) {
+    uint32_t carry = 0;
+    size_t i = 0;
+    for (; i < n; i++) {
+        uint32_t sum = out[offset + i] + x[i] + carry;
+        carry = sum >= BASE;
+        out[offset + i] = carry ? sum - BASE : sum;
+    }
+    for (size_t k = offset + i; carry && k < out_len; k++) {
+        uint32_t sum = out[k] + carry;
+        carry = sum >= BASE;
+        out[k] = carry ? sum - BASE : sum;
+    }
+}
+
+// x -= y, где x >= y
+inline void sub_in_place(Limbs& x, const Limbs& y) {
+    uint32_t borrow = 0;
+    size_t i = 0;
+    for (; i < y.size(); i++) {
+        uint32_t sub = y[i] + borrow;
+        borrow = x[i] < sub;
+        x[i] = borrow ? x[i] + BASE - sub : x[i] - sub;
+    }
+    for (; borrow && i < x.size(); i++) {
+        borrow = x[i] == 0;
+        x[i] = borrow ? BASE - 1 : x[i] - 1;
+    }
+    trim(x);
+}
+
+inline Limbs add(const uint32_t* x, size_t n, const uint32_t* y, size_t m) {
+    if (n < m) {
+        std::swap(x, y);
+        std::swap(n, m);
+    }
+    Limbs result(x, x + n);
+    result.push_back(0);
+    add_at(result.data(), result.size(), y, m, 0);
+    trim(result);
+    return result;
+}
+
+inline int compare(const Limbs& x, const Limbs& y) {
+    if (x.size() != y.size()) return x.size() < y.size() ? -1 : 1;
+    for (size_t i = x.size(); i-- > 0;) {
+        if (x[i] != y[i]) return x[i] < y[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+inline Limbs product(const Limbs& x, const Limbs& y) {
+    if (x.empty() || y.empty()) return Limbs();
+    Limbs result(x.size() + y.size());
+    multiply(x.data(), x.size(), y.data(), y.size(), result.data());
+    trim(result);
+    return result;
+}
+
+// Умножение в столбик по столбцам результата с 128-битным накоплением:
+// одно деление на лимб результата вместо одного на каждое произведение цифр
+inline void mul_schoolbook(const uint32_t* a, size_t n, const uint32_t* b, size_t m, uint32_t* out) {
+    unsigned __int128 acc = 0;
+    for (size_t k = 0; k + 1 < n + m; k++) {
+        size_t i_begin = k >= m ? k - m + 1 : 0;
+        size_t i_end = std::min(k + 1, n);
+        for (size_t i = i_begin; i < i_end; i++) {
+            acc += static_cast<uint64_t>(a[i]) * b[k - i];
+        }
+        out[k] = static_cast<uint32_t>(acc % BASE);
+        acc /= BASE;
+    }
+    out[n + m - 1] = static_cast<uint32_t>(acc);
+}
+
+// Карацуба: n >= m, n < 2m
+inline void mul_karatsuba(const uint32_t* a, size_t n, const uint32_t* b, size_t m, uint32_t* out) {
+    size_t h = (n + 1) / 2;
+    std::fill(out, out + n + m, 0);
+    if (m <= h) {
+        Limbs part(h + m);
+        multiply(a, h, b, m, part.data());
+        add_at(out, n + m, part.data(), part.size(), 0);
+        part.assign(n - h + m, 0);
+        multiply(a + h, n - h, b, m, part.data());
+        add_at(out, n + m, part.data(), part.size(), h);
+        return;
+    }
+    Limbs z0(2 * h), z2(n - h + m - h), z1;
+    auto low = [&] { multiply(a, h, b, h, z0.data()); };
+    auto high = [&] { multiply(a + h, n - h, b + h, m - h, z2.data()); };
+    auto middle = [&] { z1 = product(add(a, h, a + h, n - h), add(b, h, b + h, m - h)); };
+    if (m >= bcd_parallel::parallel_config.min_limbs) {
+        bcd_parallel::invoke(low, high, middle);
+    } else {
+        low();
+        high();
+        middle();
+    }
+    trim(z0);
+    trim(z2);
+    sub_in_place(z1, z0);
+    sub_in_place(z1, z2);
+    std::copy(z0.begin(), z0.end(), out);
+    std::copy(z2.begin(), z2.end(), out + 2 * h);
+    add_at(out, n + m, z1.data(), z1.size(), h);
+}
+
+// Число со знаком для интерполяции Тоома-3
+struct SignedLimbs {
+    Limbs mag;
+    bool negative = false;
+};
+
+inline SignedLimbs signed_add(const SignedLimbs& x, const SignedLimbs& y) {
+    SignedLimbs result;
+    if (x.negative == y.negative) {
+        result.mag = add(x.mag.data(), x.mag.size(), y.mag.data(), y.mag.size());
+        result.negative = x.negative;
+    } else if (compare(x.mag, y.mag) >= 0) {
+        result.mag = x.mag;
+        sub_in_place(result.mag, y.mag);
+        result.negative = x.negative;
+    } else {
+        result.mag = y.mag;
+        sub_in_place(result.mag, x.mag);
+        result.negative = y.negative;
+    }
+    if (result.mag.empty()) result.negative = false;
+    return result;
+}
+
+inline SignedLimbs signed_sub(const SignedLimbs& x, SignedLimbs y) {
+    if (!y.mag.empty()) y.negative = !y.negative;
+    return signed_add(x, y);
+}
+
+inline SignedLimbs signed_mul(const SignedLimbs& x, const SignedLimbs& y) {
+    SignedLimbs result;
+    result.mag = product(x.mag, y.mag);
+    result.negative = !result.mag.empty() && x.negative != y.negative;
+    return result;
+}
+
+inline SignedLimbs mul_small(SignedLimbs x, uint32_t k) {
+    uint64_t carry = 0;
+    for (uint32_t& limb : x.mag) {
+        uint64_t cur = static_cast<uint64_t>(limb) * k + carry;
+        limb = static_cast<uint32_t>(cur % BASE);
+        carry = cur / BASE;
+    }
+    if (carry) x.mag.push_back(static_cast<uint32_t>(carry));
+    return x;
+}
+
+// Точное деление на малое число
+inline SignedLimbs div_small_exact(SignedLimbs x, uint32_t k) {
+    uint64_t rem = 0;
+    for (size_t i = x.mag.size(); i-- > 0;) {
+        uint64_t cur = rem * BASE + x.mag[i];
+        x.mag[i] = static_cast<uint32_t>(cur / k);
+        rem = cur % k;
+    }
+    assert(rem == 0);
+    trim(x.mag);
+    return x;
+}
+
+inline SignedLimbs slice(const uint32_t* x, size_t n, size_t from, size_t len) {
+    SignedLimbs result;
+    if (from < n) {
+        result.mag.assign(x + from, x + std::min(n, from + len));
+        trim(result.mag);
+    }
+    return result;
+}
+
+// Тоом-3 с интерполяцией по точкам 0, 1, -1, -2, inf (последовательность Бодрато): n >= m
+inline void mul_toom3(const uint32_t* a, size_t n, const uint32_t* b, size_t m, uint32_t* out) {
+    size_t k = (n + 2) / 3;
+    if (m <= 2 * k) {
+        mul_karatsuba(a, n, b, m, out);
+        return;
+    }
+    SignedLimbs a0 = slice(a, n, 0, k), a1 = slice(a, n, k, k), a2 = slice(a, n, 2 * k, k);
+    SignedLimbs b0 = slice(b, m, 0, k), b1 = slice(b, m, k, k), b2 = slice(b, m, 2 * k, k);
+    
+    // Значения в точках
+    SignedLimbs pa = signed_add(a0, a2), pb = signed_add(b0, b2);
+    SignedLimbs pa1 = signed_add(pa, a1), pb1 = signed_add(pb, b1);
+    SignedLimbs pam1 = signed_sub(pa, a1), pbm1 = signed_sub(pb, b1);
+    SignedLimbs pam2 = signed_sub(mul_small(signed_add(pam1, a2), 2), a0);
+    SignedLimbs pbm2 = signed_sub(mul_small(signed_add(pbm1, b2), 2), b0);
+    
+    SignedLimbs r0, r1, rm1, rm2, r4;
+    bcd_parallel::invoke(
+        [&] { r0 = signed_mul(a0, b0); },
+        [&] { r1 = signed_mul(pa1, pb1); },
+        [&] { rm1 = signed_mul(pam1, pbm1); },
+        [&] { rm2 = signed_mul(pam2, pbm2); },
+        [&] { r4 = signed_mul(a2, b2); });
+    
+    // Интерполяция
+    SignedLimbs r3 = div_small_exact(signed_sub(rm2, r1), 3);
+    r1 = div_small_exact(signed_sub(r1, rm1), 2);
+    SignedLimbs r2 = signed_sub(rm1, r0);
+    r3 = signed_add(div_small_exact(signed_sub(r2, r3), 2), mul_small(r4, 2));
+    r2 = signed_sub(signed_add(r2, r1), r4);
+    r1 = signed_sub(r1, r3);
+    
+    std::fill(out, out + n + m, 0);
+    const SignedLimbs* coefficients[] = {&r0, &r1, &r2, &r3, &r4};
+    for (size_t i = 0; i < 5; i++) {
+        assert(!coefficients[i]->negative);
+        add_at(out, n + m, coefficients[i]->mag.data(), coefficients[i]->mag.size(), i * k);
+    }
+}
+
+// Теоретико-числовое преобразование по трём простым модулям с восстановлением
+// коэффициентов по КТО. Коэффициент свёртки не превосходит 2^23 * 10^18,
+// что меньше произведения модулей (~7.9 * 10^25), поэтому результат точный.
+const size_t NTT_MAX_LENGTH = size_t(1) << 23;
+
+inline uint32_t pow_mod(uint64_t x, uint64_t e, uint32_t mod) {
+    uint64_t result = 1;
+    x %= mod;
+    while (e) {
+        if (e & 1) result = result * x % mod;
+        x = x * x % mod;
+        e >>= 1;
+    }
+    return static_cast<uint32_t>(result);
+}
+
+template <uint32_t MOD>
+inline void ntt(Limbs& a, bool inverse) {
+    const uint32_t root = 3;
+    size_t n = a.size();
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+    Limbs w(n / 2);
+    for (size_t len = 2; len <= n; len <<= 1) {
+        uint32_t step = pow_mod(root, (MOD - 1) / len, MOD);
+        if (inverse) step = pow_mod(step, MOD - 2, MOD);
+        size_t half = len / 2;
+        w[0] = 1;
+        for (size_t j = 1; j < half; j++) {
+            w[j] = static_cast<uint32_t>(static_cast<uint64_t>(w[j - 1]) * step % MOD);
+        }
+        // Бабочки с номерами [from, to): t = номер блока * half + j
+        auto butterflies = [&](size_t from, size_t to) {
+            size_t i = from / half * len;
+            size_t j = from % half;
+            for (size_t t = from; t < to; i += len, j = 0) {
+                for (; j < half && t < to; j++, t++) {
+                    uint32_t u = a[i + j];
+                    uint32_t v = static_cast<uint32_t>(static_cast<uint64_t>(a[i + j + half]) * w[j] % MOD);
+                    a[i + j] = u + v >= MOD ? u + v - MOD : u + v;
+                    a[i + j + half] = u >= v ? u - v : u + MOD - v;
+                }
+            }
+        };
+        if (n >= 2 * bcd_parallel::parallel_config.min_limbs) {
+            bcd_parallel::parallel_for(0, n / 2, 4096, butterflies);
+        } else {
+            butterflies(0, n / 2);
+        }
+    }
+    if (inverse) {
+        uint64_t n_inv = pow_mod(n, MOD - 2, MOD);
+        for (uint32_t& x : a) x = static_cast<uint32_t>(x * n_inv % MOD);
+    }
+}
+
+template <uint32_t MOD>
+inline Limbs convolution_mod(const uint32_t* a, size_t n, const uint32_t* b, size_t m, size_t size) {
+    Limbs fa(size, 0), fb(size, 0);
+    for (size_t i = 0; i < n; i++) fa[i] = a[i] % MOD;
+    for (size_t i = 0; i < m; i++) fb[i] = b[i] % MOD;
+    ntt<MOD>(fa, false);
+    ntt<MOD>(fb, false);
+    for (size_t i = 0; i < size; i++) {
+        fa[i] = static_cast<uint32_t>(static_cast<uint64_t>(fa[i]) * fb[i] % MOD);
+    }
+    ntt<MOD>(fa, true);
+    return fa;
+}
+
+inline void mul_ntt(const uint32_t* a, size_t n, const uint32_t* b, size_t m, uint32_t* out) {
+    const uint32_t M1 = 998244353, M2 = 167772161, M3 = 469762049;
+    size_t size = 1;
+    while (size < n + m - 1) size <<= 1;
+    Limbs c1, c2, c3;
+    auto first = [&] { c1 = convolution_mod<M1>(a, n, b, m, size); };
+    auto second = [&] { c2 = convolution_mod<M2>(a, n, b, m, size); };
+    auto third = [&] { c3 = convolution_mod<M3>(a, n, b, m, size); };
+    if (m >= bcd_parallel::parallel_config.min_limbs) {
+        bcd_parallel::invoke(first, second, third);
+    } else {
+        first();
+        second();
+        third();
+    }
+    
+    // Алгоритм Гарнера
+    const uint64_t inv_m1_mod_m2 = pow_mod(M1, M2 - 2, M2);
+    const uint64_t inv_m1m2_mod_m3 = pow_mod(static_cast<uint64_t>(M1) * M2 % M3, M3 - 2, M3);
+    const unsigned __int128 m1m2 = static_cast<unsigned __int128>(M1) * M2;
+    unsigned __int128 carry = 0;
+    for (size_t i = 0; i < n + m; i++) {
+        unsigned __int128 value = carry;
+        if (i + 1 < n + m) {
+            uint64_t x1 = c1[i];
+            uint64_t x2 = (c2[i] + M2 - x1 % M2) % M2 * inv_m1_mod_m2 % M2;
+            uint64_t t = (x1 + x2 * M1) % M3;
+            uint64_t x3 = (c3[i] + M3 - t) % M3 * inv_m1m2_mod_m3 % M3;
+            value += x1 + static_cast<unsigned __int128>(x2) * M1 + x3 * m1m2;
+        }
+        out[i] = static_cast<uint32_t>(value % BASE);
+        carry = value / BASE;
+    }
+}
+
+// Произведение a (n лимбов) на b (m лимбов) в out (n + m лимбов) с выбором
+// алгоритма по размеру: столбик, Карацуба, Тоом-3 или NTT
+inline void multiply(const uint32_t* a, size_t n, const uint32_t* b, size_t m, uint32_t* out) {
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    size_t n_trimmed = significant_length(a, n);
+    size_t m_trimmed = significant_length(b, m);
+    if (n_trimmed == 0 || m_trimmed == 0) {
+        std::fill(out, out + n + m, 0);
+        return;
+    }
+    if (n_trimmed != n || m_trimmed != m) {
+        std::fill(out + n_trimmed + m_trimmed, out + n + m, 0);
+        multiply(a, n_trimmed, b, m_trimmed, out);
+        return;
+    }
+    
+    if (m < mul_thresholds.karatsuba) {
+        mul_schoolbook(a, n, b, m, out);
+    } else if (m >= mul_thresholds.ntt && n + m <= NTT_MAX_LENGTH) {
+        mul_ntt(a, n, b, m, out);
+    } else if (n >= 2 * m) {
+        // Несбалансированные множители: режем больший на куски длины m
+        std::fill(out, out + n + m, 0);
+        size_t chunks = (n + m - 1) / m;
+        if (m >= bcd_parallel::parallel_config.min_limbs && bcd_parallel::enabled()) {
+            // Куски перемножаем параллельно в отдельные буферы, складываем по порядку
+            std::vector<Limbs> parts(chunks);
+            bcd_parallel::parallel_for(0, chunks, 1, [&](size_t from, size_t to) {
+                for (size_t c = from; c < to; c++) {
+                    size_t len = std::min(m, n - c * m);
+                    parts[c].resize(len + m);
+                    multiply(a + c * m, len, b, m, parts[c].data());
+                }
+            });
+            for (size_t c = 0; c < chunks; c++) {
+                add_at(out, n + m, parts[c].data(), parts[c].size(), c * m);
+            }
+            return;
+        }
+        Limbs part(2 * m);
+        for (size_t offset = 0; offset < n; offset += m) {
+            size_t len = std::min(m, n - offset);
+            multiply(a + offset, len, b, m, part.data());
+            add_at(out, n + m, part.data(), len + m, offset);
+        }
+    } else if (m < mul_thresholds.toom3) {
+        mul_karatsuba(a, n, b, m, out);
+    } else {
+        mul_toom3(a, n, b, m, out);
+    }
+}
+
+// Запасные лимбы укороченного произведения
+constexpr size_t SHORT_PRODUCT_GUARD = 2;
+
+// Старшая часть произведения floor(a * b / BASE^skip) в out (n + m - skip лимбов),
+// точно как при полном умножении. Укороченный столбик считает только столбцы
+// с номера skip - SHORT_PRODUCT_GUARD: перенос из отброшенных столбцов меньше
+// min(n, m) * BASE, и если вместе с запасными лимбами он может дойти до skip,
+// результат пересчитывается полным произведением (вероятность ~ m / BASE)
+inline void multiply_high(const uint32_t* a, size_t n, const uint32_t* b, size_t m, size_t skip, uint32_t* out) {
+    if (skip >= n + m) return;
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    bool short_wins = m < mul_thresholds.karatsuba || 2 * skip >= n + m;
+    if (skip <= SHORT_PRODUCT_GUARD || m >= mul_thresholds.short_product || !short_wins) {
+        Limbs full(n + m);
+        multiply(a, n, b, m, full.data());
+        std::copy(full.begin() + skip, full.end(), out);
+        return;
+    }
+    size_t start = skip - SHORT_PRODUCT_GUARD;
+    uint32_t guard[SHORT_PRODUCT_GUARD];
+    unsigned __int128 acc = 0;
+    for (size_t k = start; k + 1 < n + m; k++) {
+        size_t i_begin = k >= m ? k - m + 1 : 0;
+        size_t i_end = std::min(k + 1, n);
+        for (size_t i = i_begin; i < i_end; i++) {
+            acc += static_cast<uint64_t>(a[i]) * b[k - i];
+        }
+        uint32_t limb = static_cast<uint32_t>(acc % BASE);
+        if (k < skip) {
+            guard[k - start] = limb;
+        } else {
+            out[k - skip] = limb;
+        }
+        acc /= BASE;
+    }
+    out[n + m - 1 - skip] = static_cast<uint32_t>(acc);
+    
+    // Неизвестный перенос в столбец start меньше m * BASE: проверяем, что запасные
+    // лимбы не переполнятся при его добавлении
+    static_assert(SHORT_PRODUCT_GUARD == 2, "guard check assumes two limbs");
+    uint64_t guard_value = static_cast<uint64_t>(guard[1]) * BASE + guard[0];
+    if (guard_value + static_cast<uint64_t>(m) * BASE >= static_cast<uint64_t>(BASE) * BASE) {
+        Limbs full(n + m);
+        multiply(a, n, b, m, full.data());
+        std::copy(full.begin() + skip, full.end(), out);
+    }
+}
+
+// Деление на машинное слово: по одному лимбу (9 цифр) за шаг, x заменяется частным,
+// возвращается остаток
+inline uint64_t divide_by_word(Limbs& x, uint64_t d) {
+    if (d <= UINT64_MAX / BASE) {
+        uint64_t rem = 0;
+        for (size_t i = x.size(); i-- > 0;) {
+            uint64_t cur = rem * BASE + x[i];
+            x[i] = static_cast<uint32_t>(cur / d);
+            rem = cur % d;
+        }
+        trim(x);
+        return rem;
+    }
+    unsigned __int128 rem = 0;
+    for (size_t i = x.size(); i-- > 0;) {
+        unsigned __int128 cur = rem * BASE + x[i];
+        x[i] = static_cast<uint32_t>(cur / d);
+        rem = cur % d;
+    }
+    trim(x);
+    return static_cast<uint64_t>(rem);
+}
+
+inline void multiply_by_word(Limbs& x, uint32_t k) {
+    uint64_t carry = 0;
+    for (uint32_t& limb : x) {
+        uint64_t cur = static_cast<uint64_t>(limb) * k + carry;
+        limb = static_cast<uint32_t>(cur % BASE);
+        carry = cur / BASE;
+    }
+    if (carry) x.push_back(static_cast<uint32_t>(carry));
+}
+
+// x * BASE^k и floor(x / BASE^k)
+inline void shift_up(Limbs& x, size_t k) {
+    if (!x.empty()) x.insert(x.begin(), k, 0);
+}
+
+inline void shift_down(Limbs& x, size_t k) {
+    x.erase(x.begin(), x.begin() + std::min(k, x.size()));
+}
+
+inline void increment(Limbs& x) {
+    size_t i = 0;
+    for (; i < x.size() && x[i] == BASE - 1; i++) x[i] = 0;
+    if (i == x.size()) {
+        x.push_back(1);
+    } else {
+        x[i]++;
+    }
+}
+
+inline Limbs to_limbs(unsigned __int128 value) {
+    Limbs result;
+    for (; value != 0; value /= BASE) {
+        result.push_back(static_cast<uint32_t>(value % BASE));
+    }
+    return result;
+}
+
+// Приближённое обратное (Brent, Zimmermann, "Modern Computer Arithmetic", алг. 3.5).
+// Для нормализованного a из n лимбов (старший лимб >= BASE / 2) возвращает X,
+// для которого a * X < BASE^(2n) <= a * (X + 2). Итерация Ньютона удваивает
+// число верных лимбов, поэтому стоимость - O(M(n)).
+inline Limbs approximate_reciprocal(const Limbs& a) {
+    size_t n = a.size();
+    if (n <= 2) {
+        unsigned __int128 value = a[0] + (n == 2 ? static_cast<unsigned __int128>(a[1]) * BASE : 0);
+        unsigned __int128 power = static_cast<unsigned __int128>(BASE) * BASE;
+        if (n == 2) power *= power;
+        return to_limbs((power - 1) / value);
+    }
+    size_t l = (n - 1) / 2;
+    size_t h = n - l;
+    Limbs x = approximate_reciprocal(Limbs(a.begin() + l, a.end()));
+    Limbs t = product(a, x);
+    Limbs power(n + h, 0);
+    power.push_back(1);
+    while (compare(t, power) >= 0) {
+        sub_in_place(x, Limbs(1, 1));
+        sub_in_place(t, a);
+    }
+    sub_in_place(power, t);
+    shift_down(power, l);
+    Limbs u = product(power, x);
+    shift_down(u, 2 * h - l);
+    shift_up(x, l);
+    x = add(x.data(), x.size(), u.data(), u.size());
+    return x;
+}
+
+// Частное floor(x / d) для d, не помещающегося в машинное слово:
+// оценка через приближённое обратное и не более трёх поправок
+inline Limbs divide_newton(Limbs x, Limbs d) {
+    // Нормализация: старший лимб делителя не меньше BASE / 2
+    uint32_t factor = BASE / (d.back() + 1);
+    multiply_by_word(d, factor);
+    multiply_by_word(x, factor);
+    
+    // Делимое должно быть не длиннее 2n лимбов - иначе удлиняем оба нулями снизу
+    if (x.size() > 2 * d.size()) {
+        size_t k = x.size() - 2 * d.size();
+        shift_up(d, k);
+        shift_up(x, k);
+    }
+    size_t n = d.size();
+    Limbs q = product(x, approximate_reciprocal(d));
+    shift_down(q, 2 * n);
+    Limbs r = x;
+    sub_in_place(r, product(q, d));
+    while (compare(r, d) >= 0) {
+        sub_in_place(r, d);
+        increment(q);
+    }
+    return q;
+}
+
+// floor(x / d) для нормализованных (без ведущих нулей) x и d != 0
+inline Limbs divide(Limbs x, const Limbs& d) {
+    assert(!d.empty());
+    if (compare(x, d) < 0) return Limbs();
+    if (d.size() <= 3) {
+        unsigned __int128 value = 0;
+        for (size_t i = d.size(); i-- > 0;) value = value * BASE + d[i];
+        if (value <= UINT64_MAX) {
+            divide_by_word(x, static_cast<uint64_t>(value));
+            return x;
+        }
+    }
+    return divide_newton(std::move(x), d);
+}
+
+// Приближённый обратный корень: для n, понимаемого как alpha = n * BASE^-2e
+// из [BASE^-2, 1), возвращает Y ~ BASE^p / sqrt(alpha) с относительной ошибкой
+// в несколько единиц BASE^-p. Итерация Ньютона y += y (1 - alpha y^2) / 2 без
+// делений удваивает число верных лимбов, и каждая идёт лишь с нужной ей
+// точностью, поэтому стоимость - O(M(p))
+inline Limbs approximate_rsqrt(const Limbs& n, size_t e, size_t p) {
+    if (p <= 2) {
+        // Старшие три лимба дают alpha точнее 10^-18
+        long double alpha = 0;
+        size_t low = n.size() > 3 ? n.size() - 3 : 0;
+        for (size_t i = n.size(); i-- > low;) alpha = alpha * BASE + n[i];
+        for (size_t i = low; i < 2 * e; i++) alpha /= BASE;
+        long double y = 1 / std::sqrt(alpha);
+        for (size_t i = 0; i < p; i++) y *= BASE;
+        return to_limbs(static_cast<unsigned __int128>(y));
+    }
+    size_t h = p / 2 + 1;
+    Limbs y = approximate_rsqrt(n, e, h);
+    shift_up(y, p - h);
+    
+    // alpha с p + 2 дробными лимбами: при alpha ~ BASE^-2 это ещё p значащих
+    Limbs alpha = n;
+    if (p + 2 >= 2 * e) {
+        shift_up(alpha, p + 2 - 2 * e);
+    } else {
+        shift_down(alpha, 2 * e - p - 2);
+    }
+    Limbs t = product(y, y);
+    shift_down(t, p);
+    t = product(alpha, t);
+    shift_down(t, p + 2);
+    
+    // Поправка y * |1 - alpha y^2| / 2 мала, и её произведение короткое
+    Limbs one(p, 0);
+    one.push_back(1);
+    bool below = compare(t, one) < 0;
+    if (below) {
+        sub_in_place(one, t);
+        t.swap(one);
+    } else {
+        sub_in_place(t, one);
+    }
+    Limbs correction = product(y, t);
+    shift_down(correction, p);
+    divide_by_word(correction, 2);
+    if (below) {
+        y = add(y.data(), y.size(), correction.data(), correction.size());
+    } else {
+        sub_in_place(y, correction);
+    }
+    return y;
+}
+
+// floor(sqrt(n)) для нормализованного n: sqrt(n) = n / sqrt(n), где обратный
+// корень считается итерацией Ньютона без делений. Оценка отличается от
+// ответа на несколько единиц, и остаток n - r^2 исправляет её за O(n) на шаг
+inline Limbs isqrt(const Limbs& n) {
+    // До 4 лимбов (< 10^36) число и квадрат корня помещаются в 128 бит
+    if (n.size() <= 4) {
+        unsigned __int128 value = 0;
+        for (size_t i = n.size(); i-- > 0;) value = value * BASE + n[i];
+        uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<long double>(value)));
+        while (static_cast<unsigned __int128>(root) * root > value) root--;
+        while (static_cast<unsigned __int128>(root + 1) * (root + 1) <= value) root++;
+        return to_limbs(root);
+    }
+    size_t e = (n.size() + 1) / 2;
+    size_t p = e + 2;
+    Limbs r = product(n, approximate_rsqrt(n, e, p));
+    shift_down(r, e + p);
+    
+    // Ответ r, если 0 <= n - r^2 <= 2r
+    SignedLimbs rest = signed_sub(SignedLimbs{n, false}, SignedLimbs{product(r, r), false});
+    while (rest.negative) {
+        rest = signed_add(rest, SignedLimbs{r, false});
+        sub_in_place(r, Limbs(1, 1));
+        rest = signed_add(rest, SignedLimbs{r, false});
+    }
+    Limbs twice = add(r.data(), r.size(), r.data(), r.size());
+    while (compare(rest.mag, twice) > 0) {
+        sub_in_place(rest.mag, twice);
+        sub_in_place(rest.mag, Limbs(1, 1));
+        increment(r);
+        twice = add(r.data(), r.size(), r.data(), r.size());
+    }
+    return r;
+}
+
+} // namespace bcd_limbs
+
+// Элементарные функции с фиксированной точкой поверх быстрого умножения bcd_limbs.
+// Корень и деление - итерации Ньютона ценой O(M(n)), логарифм - среднее
+// арифметико-геометрическое (СрАГ) за O(log n) корней, pi и ln 10 - тоже через
+// СрАГ, они кэшируются в потоке. exp, sin, cos и atan сводятся к малому
+// аргументу и ряду Тейлора, а на больших точностях exp - это итерация Ньютона
+// над логарифмом, то есть O(M(n) log n)
+namespace bcd_elementary {
+
+using bcd_limbs::Limbs;
+using bcd_limbs::SignedLimbs;
+
+// Запасные лимбы: вычисление идёт с ними, затем результат усекается
+constexpr size_t GUARD_LIMBS = 2;
+
+// С этого числа дробных лимбов exp считается итерацией Ньютона над логарифмом:
+// ряд требует O(sqrt(n)) умножений, Ньютон - O(log n) корней
+constexpr size_t EXP_NEWTON_LIMBS = 3500;
+
+// Число x понимается как x * BASE^-frac. Операции усекают модуль,
+// поэтому ошибка каждой - меньше единицы младшего лимба
+class FixedPoint {
+public:
+    explicit FixedPoint(size_t frac) : frac(frac) {}
+    
+    size_t fraction() const {
+        return frac;
+    }
+    
+    SignedLimbs integer(uint64_t value, bool negative = false) const {
+        SignedLimbs result;
+        result.mag = bcd_limbs::to_limbs(value);
+        bcd_limbs::shift_up(result.mag, frac);
+        result.negative = negative && !result.mag.empty();
+        return result;
+    }
+    
+    SignedLimbs one() const {
+        return integer(1);
+    }
+    
+    // x с from дробными лимбами в точность этого контекста
+    SignedLimbs rescale(SignedLimbs x, size_t from) const {
+        if (frac >= from) {
+            bcd_limbs::shift_up(x.mag, frac - from);
+        } else {
+            bcd_limbs::shift_down(x.mag, from - frac);
+        }
+        x.negative = x.negative && !x.mag.empty();
+        return x;
+    }
+    
+    // Младшие frac лимбов произведения не считаются
+    SignedLimbs mul(const SignedLimbs& x, const SignedLimbs& y) const {
+        SignedLimbs result;
+        size_t length = x.mag.size() + y.mag.size();
+        if (x.mag.empty() || y.mag.empty() || length <= frac) return result;
+        result.mag.resize(length - frac);
+        bcd_limbs::multiply_high(x.mag.data(), x.mag.size(), y.mag.data(), y.mag.size(), frac, result.mag.data());
+        bcd_limbs::trim(result.mag);
+        result.negative = !result.mag.empty() && x.negative != y.negative;
+        return result;
+    }
+    
+    SignedLimbs div(const SignedLimbs& x, const SignedLimbs& y) const {
+        assert(!y.mag.empty());
+        SignedLimbs result;
+        if (x.mag.empty()) return result;
+        Limbs dividend = x.mag;
+        bcd_limbs::shift_up(dividend, frac);
+        result.mag = bcd_limbs::divide(std::move(dividend), y.mag);
+        result.negative = !result.mag.empty() && x.negative != y.negative;
+        return result;
+    }
+    
+    // sqrt(x * y) для x, y >= 0: корень произведения с 2 frac дробными лимбами
+    // сразу имеет frac дробных лимбов
+    SignedLimbs geometric_mean(const SignedLimbs& x, const SignedLimbs& y) const {
+        SignedLimbs result;
+        Limbs radicand = bcd_limbs::product(x.mag, y.mag);
+        if (!radicand.empty()) {
+            result.mag = bcd_limbs::isqrt(radicand);
+        }
+        return result;
+    }
+    
+    SignedLimbs sqrt(const SignedLimbs& x) const {
+        return geometric_mean(x, one());
+    }
+    
+    static SignedLimbs div_word(SignedLimbs x, uint64_t d) {
+        bcd_limbs::divide_by_word(x.mag, d);
+        x.negative = x.negative && !x.mag.empty();
+        return x;
+    }
+    
+    // x / 2^k и x * 2^k
+    static SignedLimbs div_pow2(SignedLimbs x, size_t k) {
+        for (; k > 30; k -= 30) x = div_word(std::move(x), 1u << 30);
+        return div_word(std::move(x), 1u << k);
+    }
+    
+    static SignedLimbs mul_pow2(SignedLimbs x, size_t k) {
+        for (; k > 30; k -= 30) x = bcd_limbs::mul_small(std::move(x), 1u << 30);
+        return bcd_limbs::mul_small(std::move(x), 1u << k);
+    }
+    
+    static SignedLimbs negated(SignedLimbs x) {
+        x.negative = !x.negative && !x.mag.empty();
+        return x;
+    }
+    
+    static SignedLimbs absolute(SignedLimbs x) {
+        x.negative = false;
+        return x;
+    }
+    
+    // Ближайшее целое (половина - от нуля) как лимбы без дробной части
+    Limbs nearest_integer(const SignedLimbs& x) const {
+        Limbs result = x.mag;
+        bool round_up = frac > 0 && x.mag.size() >= frac && x.mag[frac - 1] >= bcd_limbs::BASE / 2;
+        bcd_limbs::shift_down(result, frac);
+        if (round_up) bcd_limbs::increment(result);
+        return result;
+    }
+    
+    // Число битов точности - для выбора глубины сведения аргумента
+    size_t bits() const {
+        return frac * 30;
+    }
+    
+private:
+    size_t frac;
+};
+
+// СрАГ(a, b) для a, b > 0: пока a и b не сошлись до единиц младшего лимба
+inline SignedLimbs agm(const FixedPoint& fp, SignedLimbs a, SignedLimbs b) {
+    for (;;) {
+        if (bcd_limbs::signed_sub(a, b).mag.size() <= 1) return a;
+        SignedLimbs next = FixedPoint::div_word(bcd_limbs::signed_add(a, b), 2);
+        b = fp.geometric_mean(a, b);
+        a = std::move(next);
+    }
+}
+
+// Гаусс - Лежандр (Брент - Саламин): число верных цифр удваивается за шаг.
+// Слагаемое 2^k (a_k - a_{k+1})^2 копит ошибку до k 2^k младших лимбов -
+// меньше одного запасного
+inline SignedLimbs compute_pi(const FixedPoint& fp) {
+    SignedLimbs a = fp.one();
+    SignedLimbs b = fp.sqrt(FixedPoint::div_word(fp.one(), 2));
+    SignedLimbs t = FixedPoint::div_word(fp.one(), 4);
+    for (uint32_t power = 1; ; power *= 2) {
+        SignedLimbs next = FixedPoint::div_word(bcd_limbs::signed_add(a, b), 2);
+        SignedLimbs step = bcd_limbs::signed_sub(a, next);
+        t = bcd_limbs::signed_sub(t, bcd_limbs::mul_small(fp.mul(step, step), power));
+        b = fp.geometric_mean(a, b);
+        a = std::move(next);
+        if (bcd_limbs::signed_sub(a, b).mag.size() <= 1) break;
+    }
+    SignedLimbs sum = bcd_limbs::signed_add(a, b);
+    return fp.div(fp.mul(sum, sum), bcd_limbs::mul_small(t, 4));
+}
+
+// ln s = pi s / (2 СрАГ(s, 4)) с ошибкой O(ln s / s^2): СрАГ(s, 4) = s СрАГ(1, 4 / s).
+// Для s >= BASE^(frac / 2 + 2) ошибка формулы меньше младшего лимба
+inline SignedLimbs log_large(const FixedPoint& fp, const SignedLimbs& s, const SignedLimbs& pi) {
+    SignedLimbs mean = agm(fp, s, fp.integer(4));
+    return fp.div(fp.mul(pi, s), bcd_limbs::mul_small(mean, 2));
+}
+
+// ln 10 = ln(BASE^m) / (9 m)
+inline SignedLimbs compute_ln10(const FixedPoint& fp, const SignedLimbs& pi) {
+    size_t m = fp.fraction() / 2 + 3;
+    SignedLimbs s;
+    s.mag.assign(fp.fraction() + m, 0);
+    s.mag.push_back(1);
+    return FixedPoint::div_word(log_large(fp, s, pi), 9 * static_cast<uint64_t>(m));
+}
+
+// pi и ln 10 с наибольшей посчитанной в потоке точностью: повторные вызовы
+// с той же или меньшей точностью только усекают их
+struct ConstantCache {
+    size_t frac = 0;
+    SignedLimbs pi;
+    SignedLimbs ln10;
+};
+
+inline const ConstantCache& constants(size_t frac) {
+    static thread_local ConstantCache cache;
+    if (cache.frac < frac) {
+        FixedPoint work(frac + GUARD_LIMBS);
+        cache.pi = compute_pi(work);
+        cache.ln10 = compute_ln10(work, cache.pi);
+        cache.frac = work.fraction();
+    }
+    return cache;
+}
+
+inline SignedLimbs pi(const FixedPoint& fp) {
+    const ConstantCache& cache = constants(fp.fraction());
+    return fp.rescale(cache.pi, cache.frac);
+}
+
+inline SignedLimbs ln10(const FixedPoint& fp) {
+    const ConstantCache& cache = constants(fp.fraction());
+    return fp.rescale(cache.ln10, cache.frac);
+}
+
+// ln x для x = mag * BASE^-mag_frac > 0. Сдвиг s = x * BASE^m точный, поэтому
+// малые x не теряют значащих цифр: ln x = ln s - 9 m ln 10
+inline SignedLimbs log(const FixedPoint& fp, const Limbs& mag, size_t mag_frac) {
+    assert(!mag.empty());
+    long long top = static_cast<long long>(mag.size()) - static_cast<long long>(mag_frac);
+    long long m = static_cast<long long>(fp.fraction() / 2 + 3) - top;
+    SignedLimbs s;
+    s.mag = mag;
+    long long shift = static_cast<long long>(fp.fraction()) + m - static_cast<long long>(mag_frac);
+    if (shift >= 0) {
+        bcd_limbs::shift_up(s.mag, shift);
+    } else {
+        bcd_limbs::shift_down(s.mag, -shift);
+    }
+    
+    // 9 |m| ln 10 накапливает ошибку ln 10 в 9 |m| раз: берём его на лимб точнее
+    SignedLimbs result = log_large(fp, s, pi(fp));
+    if (m == 0) return result;
+    FixedPoint wide(fp.fraction() + 1);
+    SignedLimbs offset = bcd_limbs::mul_small(ln10(wide), 9 * static_cast<uint32_t>(m < 0 ? -m : m));
+    offset = fp.rescale(offset, wide.fraction());
+    return m >= 0 ? bcd_limbs::signed_sub(result, offset) : bcd_limbs::signed_add(result, offset);
+}
+
+// e^r для |r| <= 2: ряд Тейлора для r / 2^k и k возведений в квадрат.
+// k ~ sqrt(битов точности) уравновешивает число членов ряда и квадратов;
+// каждый квадрат удваивает относительную ошибку, под это берутся запасные лимбы
+inline SignedLimbs exp_series(const FixedPoint& fp, const SignedLimbs& r) {
+    size_t k = static_cast<size_t>(std::sqrt(static_cast<double>(fp.bits())));
+    FixedPoint work(fp.fraction() + k / 29 + 1);
+    SignedLimbs x = FixedPoint::div_pow2(work.rescale(r, fp.fraction()), k);
+    SignedLimbs sum = work.one();
+    SignedLimbs term = work.one();
+    for (uint32_t i = 1; !term.mag.empty(); i++) {
+        term = FixedPoint::div_word(work.mul(term, x), i);
+        sum = bcd_limbs::signed_add(sum, term);
+    }
+    for (size_t i = 0; i < k; i++) {
+        sum = work.mul(sum, sum);
+    }
+    return fp.rescale(sum, work.fraction());
+}
+
+// e^r для |r| <= 2. На больших точностях y = e^r с половиной лимбов
+// уточняется шагом Ньютона y (1 + r - ln y): ошибка возводится в квадрат
+inline SignedLimbs exp(const FixedPoint& fp, const SignedLimbs& r) {
+    if (fp.fraction() < EXP_NEWTON_LIMBS) {
+        return exp_series(fp, r);
+    }
+    FixedPoint half(fp.fraction() / 2 + GUARD_LIMBS);
+    SignedLimbs y = fp.rescale(exp(half, half.rescale(r, fp.fraction())), half.fraction());
+    SignedLimbs error = bcd_limbs::signed_sub(r, log(fp, y.mag, fp.fraction()));
+    return bcd_limbs::signed_add(y, fp.mul(y, error));
+}
+
+// sin r и cos r для |r| <= 1: ряд для sin(r / 2^k), cos = sqrt(1 - sin^2),
+// затем k удвоений угла: sin 2a = 2 sin a cos a, cos 2a = 1 - 2 sin^2 a
+inline std::pair<SignedLimbs, SignedLimbs> sin_cos(const FixedPoint& fp, const SignedLimbs& r) {
+    size_t k = static_cast<size_t>(std::sqrt(static_cast<double>(fp.bits())) / 2);
+    FixedPoint work(fp.fraction() + k / 29 + 1);
+    SignedLimbs x = FixedPoint::div_pow2(work.rescale(r, fp.fraction()), k);
+    SignedLimbs square = work.mul(x, x);
+    SignedLimbs sine = x;
+    SignedLimbs term = x;
+    for (uint64_t i = 2; !term.mag.empty(); i += 2) {
+        term = FixedPoint::negated(FixedPoint::div_word(work.mul(term, square), i * (i + 1)));
+        sine = bcd_limbs::signed_add(sine, term);
+    }
+    SignedLimbs cosine = work.sqrt(bcd_limbs::signed_sub(work.one(), work.mul(sine, sine)));
+    for (size_t i = 0; i < k; i++) {
+        SignedLimbs doubled = bcd_limbs::mul_small(work.mul(sine, cosine), 2);
+        cosine = bcd_limbs::signed_sub(work.one(), bcd_limbs::mul_small(work.mul(sine, sine), 2));
+        sine = std::move(doubled);
+    }
+    return {fp.rescale(sine, work.fraction()), fp.rescale(cosine, work.fraction())};
+}
+
+// atan x для |x| <= 1: k делений угла пополам x -> x / (1 + sqrt(1 + x^2)),
+// затем ряд x - x^3 / 3 + x^5 / 5 - ... и умножение на 2^k
+inline SignedLimbs atan_reduced(const FixedPoint& fp, const SignedLimbs& x) {
+    size_t k = static_cast<size_t>(std::sqrt(static_cast<double>(fp.bits())) / 4);
+    FixedPoint work(fp.fraction() + k / 29 + 1);
+    SignedLimbs y = work.rescale(x, fp.fraction());
+    for (size_t i = 0; i < k; i++) {
+        SignedLimbs root = work.sqrt(bcd_limbs::signed_add(work.one(), work.mul(y, y)));
+        y = work.div(y, bcd_limbs::signed_add(work.one(), root));
+    }
+    SignedLimbs square = work.mul(y, y);
+    SignedLimbs power = y;
+    SignedLimbs sum = y;
+    for (uint64_t i = 3; ; i += 2) {
+        power = FixedPoint::negated(work.mul(power, square));
+        if (power.mag.empty()) break;
+        sum = bcd_limbs::signed_add(sum, FixedPoint::div_word(power, i));
+    }
+    return fp.rescale(FixedPoint::mul_pow2(sum, k), work.fraction());
+}
+
+// atan x для любого x: при |x| > 1 atan x = +-pi / 2 - atan(1 / x)
+inline SignedLimbs atan(const FixedPoint& fp, const SignedLimbs& x) {
+    if (bcd_limbs::compare(x.mag, fp.one().mag) <= 0) {
+        return atan_reduced(fp, x);
+    }
+    SignedLimbs half_pi = FixedPoint::div_word(pi(fp), 2);
+    half_pi.negative = x.negative;
+    return bcd_limbs::signed_sub(half_pi, atan_reduced(fp, fp.div(fp.one(), x)));
+}
+
+} // namespace bcd_elementary
+
+// Округление отбрасываемых при выводе цифр. HalfUp - половина от нуля,
+// HalfEven - половина к чётной цифре, Ceiling и Floor - к +-бесконечности
+enum class BCDRounding { Truncate, HalfUp, HalfEven, Ceiling, Floor };
+
+// Формат вывода BCD: precision - знаков после точки (меньше нуля - точность
+// самого числа, недостающие знаки - нули), group_separator разделяет группы
+// по group_size цифр целой части (0 - без разделителя)
+struct BCDFormat {
+    int precision = -1;
+    BCDRounding rounding = BCDRounding::Truncate;
+    char group_separator = 0;
+    int group_size = 3;
+    char decimal_point = '.';
+};
+
+template <int IntDigits, int FracDigits>
+class FixedBCD;
+
+class BCD {
+public:
+    // Разбор без копий строки: цифры сразу пишутся в лимбы. Формат:
+    // [-]цифры[(.|,)[цифры]] или [-](.|,)цифры - хотя бы одна цифра, разделитель
+    // дробной части - точка или запятая ("5.", ".5" и "-,5" допустимы). Пустая
+    // строка - ноль. "-", ".", знак "+", пробелы и любые лишние символы -
+    // invalid_argument (исходный разбор через stoul пропускал "+1", " 1", "1a")
+    BCD(std::string_view str) {
+        if (str.empty()) return;
+        std::from_chars_result parsed = from_chars(str.data(), str.data() + str.size(), *this);
+        if (parsed.ec != std::errc() || parsed.ptr != str.data() + str.size()) {
+            throw std::invalid_argument("BCD: invalid digit");
+        }
+    }
+
+    BCD(int l, std::string_view r = "") : is_negative(l < 0) {
+        assign_digits("", r);
+        append_integer(l < 0 ? 0 - static_cast<uint64_t>(l) : static_cast<uint64_t>(l));
+    }
+    
+    BCD() : is_negative(false) {}
+    
+    // В духе std::from_chars: без исключений, формат тот же, что у конструктора,
+    // но пустой ввод - ошибка, а разбор останавливается на первом лишнем символе
+    // (ptr указывает за разобранным числом). При ошибке value не меняется
+    friend std::from_chars_result from_chars(const char* first, const char* last, BCD& value) {
+        const char* p = first;
+        if (p != last && *p == '-') p++;
+        if (p != last && (*p == '.' || *p == ',')) p++;
+        if (p == last || !is_digit(*p)) {
+            return {first, std::errc::invalid_argument};
+        }
+        return {value.parse(first, last), std::errc()};
+    }
+    
+    BCD(const BCD& other) = default;
+    
+    BCD(BCD&& other) noexcept
+        : is_negative(std::move(other.is_negative))
+        , limbs(std::move(other.limbs))
+        , precision(std::move(other.precision)) {}
+
+    BCD& operator=(BCD&& other) noexcept {
+        is_negative = std::move(other.is_negative);
+        limbs = std::move(other.limbs);
+        precision = std::move(other.precision);
+        return *this;
+    }
+    
+    BCD& operator=(const BCD& other) = default;
+    
+    // Округления возвращают BCD без дробной части, чтобы работать при любой величине
+    BCD ceil() const {
+        return integer_rounded(!is_negative && !is_zero_fractional());
+    }
+    
+    BCD floor() const {
+        return integer_rounded(is_negative && !is_zero_fractional());
+    }
+    
+    BCD round() const {
+        if (precision == 0) {
+            return integer_rounded(false);
+        }
+        // Первая цифра после точки - старшая цифра старшего дробного лимба
+        int first_digit = limbs[fraction_limbs() - 1] / (BASE / 10);
+        return integer_rounded(first_digit >= 5);
+    }
+    
+    BCD operator+(const BCD& other) const {
+        BCD result;
+        add_into(*this, other, other.is_negative, result);
+        return result;
+    }
+    
+    // Составные операторы считают результат в буфере потока и меняются с ним
+    // лимбами, поэтому в цикле с операндами постоянной длины память не выделяется
+    BCD& operator+=(const BCD& other) {
+        return assign_in_place([&](BCD& result) { add_into(*this, other, other.is_negative, result); });
+    }
+    
+    // Вычитание - сложение с противоположным знаком без копии вычитаемого
+    BCD operator-(const BCD& other) const {
+        BCD result;
+        add_into(*this, other, negated_sign(other), result);
+        return result;
+    }
+    
+    BCD& operator-=(const BCD& other) {
+        return assign_in_place([&](BCD& result) { add_into(*this, other, negated_sign(other), result); });
+    }
+    
+    BCD operator*(const BCD& other) const {
+        BCD result;
+        multiply_into(*this, other, result);
+        return result;
+    }
+    
+    BCD& operator*=(const BCD& other) {
+        return assign_in_place([&](BCD& result) { multiply_into(*this, other, result); });
+    }
+    
+    // Частное, усечённое до precision знаков после точки
+    BCD divide(const BCD& other, int precision) const {
+        BCD result;
+        divide_into(*this, other, precision, result);
+        return result;
+    }
+    
+    // Частное считается с точностью более точного из операндов
+    BCD operator/(const BCD& other) const {
+        return divide(other, std::max(get_precision(), other.get_precision()));
+    }
+    
+    BCD& operator/=(const BCD& other) {
+        int quotient_precision = std::max(get_precision(), other.get_precision());
+        return assign_in_place([&](BCD& result) { divide_into(*this, other, quotient_precision, result); });
+    }
+    
+    // 1 / x с precision знаками: деление на слово для машинных делителей,
+    // итерация Ньютона поверх быстрого умножения для длинных
+    static BCD reciprocal(const BCD& x, int precision) {
+        return BCD(1).divide(x, precision);
+    }
+    
+    // Квадратный корень, усечённый до precision знаков после точки
+    static BCD sqrt(const BCD& x, int precision) {
+        if (x.is_negative && !x.is_zero()) {
+            throw std::runtime_error("BCD: sqrt of negative number");
+        }
+        if (precision < 0) precision = 0;
+        
+        // sqrt(X * BASE^-f) * BASE^F = sqrt(X * BASE^(2F - f)), F - число дробных лимбов корня
+        bcd_limbs::Limbs radicand(x.limbs);
+        bcd_limbs::trim(radicand);
+        long long shift = 2 * static_cast<long long>(limbs_for(precision)) - static_cast<long long>(x.fraction_limbs());
+        if (shift >= 0) {
+            bcd_limbs::shift_up(radicand, shift);
+        } else {
+            bcd_limbs::shift_down(radicand, -shift);
+        }
+        
+        BCD result;
+        if (!radicand.empty()) {
+            result.limbs = bcd_limbs::isqrt(radicand);
+        }
+        result.finish_quotient(precision, false);
+        return result;
+    }
+    
+    // Элементарные функции с precision знаками после точки. Вычисление идёт
+    // с запасными лимбами и усекается, поэтому последний знак может отличаться
+    // от точного усечения на единицу, когда значение почти целое в этом знаке
+    static BCD pi(int precision) {
+        bcd_elementary::FixedPoint fp(working_limbs(precision));
+        return from_fixed(bcd_elementary::pi(fp), fp.fraction(), precision);
+    }
+    
+    // e^x = 10^k e^r, k - ближайшее к x / ln 10. e^r считается с точностью,
+    // нужной для precision знаков после точки у числа из k целых цифр
+    static BCD exp(const BCD& x, int precision) {
+        if (precision < 0) precision = 0;
+        if (x.integer_digits() > 9) {
+            if (!x.is_negative) {
+                throw std::runtime_error("BCD: exp overflow");
+            }
+            return from_fixed(bcd_limbs::SignedLimbs(), 0, precision);
+        }
+        bcd_elementary::FixedPoint rough(2);
+        bcd_limbs::Limbs quotient = rough.nearest_integer(rough.div(to_fixed(x, 2), bcd_elementary::ln10(rough)));
+        long long k = quotient.empty() ? 0 : quotient[0];
+        if (quotient.size() > 1) k += static_cast<long long>(quotient[1]) * BASE;
+        if (x.is_negative) k = -k;
+        if (k > MAX_EXP_DIGITS) {
+            throw std::runtime_error("BCD: exp overflow");
+        }
+        if (precision + k + 1 < 0) {
+            return from_fixed(bcd_limbs::SignedLimbs(), 0, precision);
+        }
+        
+        // r = x - k ln 10: ln 10 нужен точнее на число лимбов k
+        bcd_elementary::FixedPoint fp(working_limbs(static_cast<int>(precision + std::max(k, 0LL) + 1)));
+        bcd_elementary::FixedPoint wide(fp.fraction() + 2);
+        bcd_limbs::SignedLimbs offset;
+        if (k != 0) {
+            offset = bcd_limbs::mul_small(bcd_elementary::ln10(wide), static_cast<uint32_t>(k < 0 ? -k : k));
+            offset.negative = k < 0;
+        }
+        bcd_limbs::SignedLimbs r = fp.rescale(bcd_limbs::signed_sub(to_fixed(x, wide.fraction()), offset), wide.fraction());
+        bcd_limbs::SignedLimbs power = bcd_elementary::exp(fp, r);
+        
+        // Умножение на 10^k = 10^(k mod 9) BASE^(k div 9) - сдвиг лимбов
+        long long shift = k >= 0 ? k / BASE_DIGITS : -((-k + BASE_DIGITS - 1) / BASE_DIGITS);
+        bcd_limbs::multiply_by_word(power.mag, pow10(static_cast<int>(k - shift * BASE_DIGITS)));
+        return from_fixed(std::move(power), static_cast<long long>(fp.fraction()) - shift, precision);
+    }
+    
+    static BCD log(const BCD& x, int precision) {
+        if (x.is_negative || x.is_zero()) {
+            throw std::runtime_error("BCD: log of non-positive number");
+        }
+        bcd_limbs::Limbs mag(x.limbs);
+        bcd_limbs::trim(mag);
+        bcd_elementary::FixedPoint fp(working_limbs(precision));
+        return from_fixed(bcd_elementary::log(fp, mag, x.fraction_limbs()), fp.fraction(), precision);
+    }
+    
+    static BCD sin(const BCD& x, int precision) {
+        bcd_elementary::FixedPoint fp(working_limbs(precision));
+        return from_fixed(sin_cos(x, fp).first, fp.fraction(), precision);
+    }
+    
+    static BCD cos(const BCD& x, int precision) {
+        bcd_elementary::FixedPoint fp(working_limbs(precision));
+        return from_fixed(sin_cos(x, fp).second, fp.fraction(), precision);
+    }
+    
+    static BCD tan(const BCD& x, int precision) {
+        return trigonometric_ratio(x, precision, false);
+    }
+    
+    static BCD cot(const BCD& x, int precision) {
+        if (x.is_zero()) {
+            throw std::runtime_error("BCD: cot of zero");
+        }
+        return trigonometric_ratio(x, precision, true);
+    }
+    
+    static BCD atan(const BCD& x, int precision) {
+        bcd_elementary::FixedPoint fp(working_limbs(precision));
+        return from_fixed(bcd_elementary::atan(fp, to_fixed(x, fp.fraction())), fp.fraction(), precision);
+    }
+    
+    // Угол точки (x, y), как std::atan2(y, x). Отношение меньшего модуля
+    // к большему делится точно, без потери значащих цифр малых координат
+    static BCD atan2(const BCD& y, const BCD& x, int precision) {
+        bcd_elementary::FixedPoint fp(working_limbs(precision));
+        if (x.is_zero() && y.is_zero()) {
+            return from_fixed(bcd_limbs::SignedLimbs(), 0, precision);
+        }
+        int digits = static_cast<int>(fp.fraction()) * BASE_DIGITS;
+        bcd_limbs::SignedLimbs angle;
+        if (compare_magnitudes(y, x) <= 0) {
+            angle = bcd_elementary::atan_reduced(fp, to_fixed(y.divide(x, digits), fp.fraction()));
+            if (x.is_negative) {
+                bcd_limbs::SignedLimbs turn = bcd_elementary::pi(fp);
+                turn.negative = y.is_negative && !y.is_zero();
+                angle = bcd_limbs::signed_add(angle, turn);
+            }
+        } else {
+            bcd_limbs::SignedLimbs quarter = bcd_elementary::FixedPoint::div_word(bcd_elementary::pi(fp), 2);
+            quarter.negative = y.is_negative;
+            angle = bcd_elementary::atan_reduced(fp, to_fixed(x.divide(y, digits), fp.fraction()));
+            angle = bcd_limbs::signed_sub(quarter, angle);
+        }
+        return from_fixed(std::move(angle), fp.fraction(), precision);
+    }
+    
+    // x^y. Целая степень считается точно двоичным возведением (и обратным
+    // для y < 0), остальные - как e^(y ln x) для x > 0
+    static BCD pow(const BCD& x, const BCD& y, int precision) {
+        if (precision < 0) precision = 0;
+        if (y.is_zero_fractional() && y.integer_limbs() <= 1) {
+            // Размер степени - по значащим лимбам: нулевые младшие (дробь 10.000
+            // при большой точности) в произведение не входят
+            uint32_t n = y.integer_limbs() == 0 ? 0 : y.limbs.back();
+            size_t significant = x.limbs.size() - x.low_zero_limbs();
+            if (n == 0 || significant * static_cast<unsigned long long>(n) <= MAX_EXACT_POWER_LIMBS) {
+                return integer_power(x, n, y.is_negative && !y.is_zero(), precision);
+            }
+        }
+        if (x.is_zero()) {
+            if (y.is_negative) {
+                throw std::runtime_error("BCD: division by zero");
+            }
+            return from_fixed(bcd_limbs::SignedLimbs(), 0, precision);
+        }
+        if (x.is_negative) {
+            if (!y.is_zero_fractional()) {
+                throw std::runtime_error("BCD: pow of negative number to fractional power");
+            }
+            BCD result = pow(-x, y, precision);
+            bool odd = y.limbs[y.fraction_limbs()] % 2 == 1;
+            return odd ? -result : result;
+        }
+        
+        // Порядок результата по грубому y ln x: e^(y ln x) имеет до y ln x / ln 10
+        // целых цифр, и на них y ln x нужен точнее. Ошибка ln x умножается на |y|,
+        // а произведение теряет 1 + число цифр большей целой части множителей
+        BCD rough_log = log(x, 10);
+        BCD rough = rough_log * widened(y, 10);
+        int result_digits = 0;
+        if (!rough.is_negative) {
+            // Оценка чуть завышена (10/23 > 1/ln 10): явно большой результат
+            // отвергается до дорогого ln x, пограничный решает exp
+            long long estimate = rough.integer_digits() > 9 ? LLONG_MAX : rough.integer_part() * 10 / 23 + 1;
+            if (estimate > MAX_EXP_DIGITS + MAX_EXP_DIGITS / 100) {
+                throw std::runtime_error("BCD: exp overflow");
+            }
+            result_digits = static_cast<int>(std::min<long long>(estimate, MAX_EXP_DIGITS));
+        }
+        int exponent_precision = precision + result_digits + BASE_DIGITS;
+        int extra = 1 + std::max(y.integer_digits(), rough_log.integer_digits()) + y.integer_digits();
+        BCD exponent = log(x, exponent_precision + extra) * widened(y, exponent_precision + extra);
+        return exp(exponent, precision);
+    }
+    
+    // Точные сумма count чисел и сумма попарных произведений через
+    // BCDAccumulator: точность - наибольшая у слагаемых (у произведения -
+    // сумма точностей множителей). При включённом пуле потоков отрезки
+    // массива суммируются параллельно
+    static BCD sum(const BCD* values, size_t count);
+    static BCD dot(const BCD* a, const BCD* b, size_t count);
+    
+    // Устойчивая сортировка count чисел по возрастанию поразрядной сортировкой
+    // MSD: числа делятся на группы по знаку и числу целых лимбов, внутри группы
+    // раскладываются по 10-битным частям лимбов от старших к младшим. Короткие
+    // отрезки досортировываются сравнением. Равные числа разной точности
+    // сохраняют исходный порядок
+    static void sort(BCD* values, size_t count);
+    
+    // BASE^F / |n| - единица в лимбе F, делённая на слово, без временных BCD
+    static BCD reciprocal(long long n, int precision) {
+        if (n == 0) {
+            throw std::runtime_error("BCD: division by zero");
+        }
+        if (precision < 0) precision = 0;
+        BCD result;
+        result.limbs.assign(limbs_for(precision) + 1, 0);
+        result.limbs.back() = 1;
+        bcd_limbs::divide_by_word(result.limbs, n < 0 ? 0 - static_cast<uint64_t>(n) : static_cast<uint64_t>(n));
+        result.finish_quotient(precision, n < 0);
+        return result;
+    }
+    
+    BCD operator+() const {
+        return *this;
+    }
+    
+    BCD operator-() const {
+        BCD result = *this;
+        if (!result.is_zero()) {
+            result.is_negative = !result.is_negative;
+        }
+        return result;
+    }
+    
+    // Трёхстороннее сравнение: -1, 0 или 1. Память не выделяется, нули в конце
+    // дробной части не учитываются (1.5 == 1.500)
+    static int compare(const BCD& a, const BCD& b) {
+        if (a.is_negative != b.is_negative) {
+            return a.is_negative ? -1 : 1;
+        }
+        int cmp = compare_magnitudes(a, b);
+        return a.is_negative ? -cmp : cmp;
+    }
+    
+    // Операторы сравнения
+    bool operator==(const BCD& other) const {
+        if (is_negative != other.is_negative) return false;
+        return compare_magnitudes(*this, other) == 0;
+    }
+    
+    bool operator!=(const BCD& other) const {
+        return !(*this == other);
+    }
+    
+    bool operator<(const BCD& other) const {
+        return compare(*this, other) < 0;
+    }
+    
+    bool operator>(const BCD& other) const {
+        return other < *this;
+    }
+    
+    bool operator<=(const BCD& other) const {
+        return !(other < *this);
+    }
+    
+    bool operator>=(const BCD& other) const {
+        return !(*this < other);
+    }
+    
+    int get_precision() const {
+        return precision;
+    }
+    
+    // Число десятичных цифр целой части (0 для нулевой целой части)
+    int integer_digits() const {
+        size_t count = integer_limbs();
+        if (count == 0) return 0;
+        int digits = static_cast<int>(count - 1) * BASE_DIGITS;
+        for (uint32_t top = limbs.back(); top != 0; top /= 10) digits++;
+        return digits;
+    }
+    
+    bool is_zero() const {
+        return bcd_limbs::kernels().is_zero_n(limbs.data(), limbs.size());
+    }
+    
+    // Хеш, согласованный с ==: младшие нулевые дробные лимбы пропускаются,
+    // а положение точки учитывается числом оставшихся дробных лимбов
+    size_t hash() const {
+        size_t frac = fraction_limbs();
+        size_t low = 0;
+        while (low < frac && limbs[low] == 0) low++;
+        uint64_t h = (frac - low) * 0x9E3779B97F4A7C15ull ^ is_negative;
+        for (size_t i = low; i < limbs.size(); i++) {
+            h = (h ^ limbs[i]) * 0x9E3779B97F4A7C15ull;
+            h ^= h >> 32;
+        }
+        return static_cast<size_t>(h);
+    }
+    
+    // Метод для установки точности
+    void set_precision(int new_precision) {
+        if (new_precision < 0) new_precision = 0;
+        size_t old_limbs = fraction_limbs();
+        size_t new_limbs = limbs_for(new_precision);
+        if (new_limbs > old_limbs) {
+            // Новые младшие лимбы нулевые
+            limbs.insert(limbs.begin(), new_limbs - old_limbs, 0);
+        } else if (new_limbs < old_limbs) {
+            limbs.erase(limbs.begin(), limbs.begin() + (old_limbs - new_limbs));
+        }
+        bool shortened = new_precision < precision;
+        precision = new_precision;
+        clear_tail();
+        // -0.001 с точностью 0 - ноль, а не минус ноль
+        if (shortened) {
+            is_negative = is_negative && !is_zero();
+        }
+    }
+    
+    // Длина текста to_chars с форматом format
+    size_t formatted_size(const BCDFormat& format = {}) const {
+        return FormatPlan(*this, format).length;
+    }
+    
+    // Текст числа в [first, last) в духе std::to_chars: без завершающего нуля,
+    // при нехватке места - {last, value_too_large}. Округление идёт по лимбам
+    // числа без их копии, память не выделяется
+    friend std::to_chars_result to_chars(char* first, char* last, const BCD& value, const BCDFormat& format = {}) {
+        FormatPlan plan(value, format);
+        if (last - first < static_cast<std::ptrdiff_t>(plan.length)) {
+            return {last, std::errc::value_too_large};
+        }
+        char* out = first;
+        if (plan.negative) *out++ = '-';
+        size_t top = plan.top_limbs;
+        size_t frac = value.fraction_limbs();
+        char digits[BASE_DIGITS];
+        if (top == frac) {
+            *out++ = '0';
+        } else if (!plan.group_separator) {
+            // Старший лимб без ведущих нулей, остальные - по 9 цифр
+            write_limb(digits, plan.limb(top - 1));
+            std::memcpy(out, digits + BASE_DIGITS - plan.top_digits, plan.top_digits);
+            out += plan.top_digits;
+            for (size_t i = top - 1; i-- > frac; out += BASE_DIGITS) {
+                write_limb(out, plan.limb(i));
+            }
+        } else {
+            // С группами цифры идут справа налево, разделитель - перед каждой полной группой
+            char* p = out + plan.integer_chars;
+            int written = 0;
+            for (size_t i = frac; i < top; i++) {
+                uint32_t limb = plan.limb(i);
+                int count = i + 1 == top ? plan.top_digits : BASE_DIGITS;
+                for (int k = 0; k < count; k++, written++) {
+                    if (written > 0 && written % plan.group_size == 0) {
+                        *--p = plan.group_separator;
+                    }
+                    *--p = static_cast<char>('0' + limb % 10);
+                    limb /= 10;
+                }
+            }
+            out += plan.integer_chars;
+        }
+        
+        if (plan.precision > 0) {
+            *out++ = format.decimal_point;
+            int remaining = plan.kept;
+            for (size_t i = frac; remaining >= BASE_DIGITS; remaining -= BASE_DIGITS, out += BASE_DIGITS) {
+                write_limb(out, plan.limb(--i));
+            }
+            if (remaining > 0) {
+                write_limb(digits, plan.limb(frac - limbs_for(plan.kept)));
+                std::memcpy(out, digits, remaining);
+                out += remaining;
+            }
+            std::memset(out, '0', plan.precision - plan.kept);
+            out += plan.precision - plan.kept;
+        }
+        return {out, std::errc()};
+    }
+    
+    // Короткие числа форматируются на стеке, длинные - в строке
+    friend std::ostream& operator<<(std::ostream& os, const BCD& bcd) {
+        char small[128];
+        size_t length = bcd.formatted_size();
+        if (length <= sizeof(small)) {
+            to_chars(small, small + length, bcd);
+            return os.write(small, length);
+        }
+        std::string text(length, '0');
+        to_chars(&text[0], &text[0] + length, bcd);
+        return os.write(text.data(), length);
+    }
+    
+    // Двоичная запись: слово длины (число лимбов), слово точности со знаком
+    // в старшем бите, затем лимбы от младшего. Слова - uint32_t в порядке байтов
+    // машины, лимбы те же, что в памяти, поэтому запись и чтение - копирование.
+    // binary_size() - размер записи в байтах
+    size_t binary_size() const {
+        return 2 * sizeof(uint32_t) + limbs.size() * sizeof(uint32_t);
+    }
+    
+    // Наибольшая точность в записи: у большей limbs_for переполнил бы int
+    static constexpr uint32_t MAX_BINARY_PRECISION = INT_MAX - bcd_limbs::BASE_DIGITS;
+    
+    // Пишет запись в out и возвращает указатель за ней
+    char* to_binary(char* out) const {
+        uint32_t header[2] = {static_cast<uint32_t>(limbs.size()),
+                              static_cast<uint32_t>(precision) | (is_negative ? 0x80000000u : 0)};
+        std::memcpy(out, header, sizeof(header));
+        // У нуля лимбов нет, и data() может быть нулевым указателем
+        if (!limbs.empty()) {
+            std::memcpy(out + sizeof(header), limbs.data(), limbs.size() * sizeof(uint32_t));
+        }
+        return out + binary_size();
+    }
+    
+    // Чтение записи из [first, last) в духе from_chars: ptr - за записью, при
+    // обрезанной или испорченной записи (лимб вне основания, цифры за точностью,
+    // ведущий нулевой лимб) - invalid_argument, и value не меняется
+    friend std::from_chars_result from_binary(const char* first, const char* last, BCD& value) {
+        uint32_t header[2];
+        size_t available = static_cast<size_t>(last - first);
+        if (available < sizeof(header)) {
+            return {first, std::errc::invalid_argument};
+        }
+        std::memcpy(header, first, sizeof(header));
+        size_t length = header[0];
+        uint32_t precision = header[1] & 0x7FFFFFFF;
+        if ((available - sizeof(header)) / sizeof(uint32_t) < length || precision > MAX_BINARY_PRECISION) {
+            return {first, std::errc::invalid_argument};
+        }
+        BCD result;
+        result.precision = static_cast<int>(precision);
+        result.is_negative = (header[1] >> 31) != 0;
+        result.limbs.resize(length);
+        if (length != 0) {
+            std::memcpy(result.limbs.data(), first + sizeof(header), length * sizeof(uint32_t));
+        }
+        if (!result.is_canonical()) {
+            return {first, std::errc::invalid_argument};
+        }
+        value = std::move(result);
+        return {first + sizeof(header) + length * sizeof(uint32_t), std::errc()};
+    }
+    bool is_negative = false;
+private:
+    template <int IntDigits, int FracDigits>
+    friend class FixedBCD;
+    friend class BCDAccumulator;
+    
+    // Модуль числа хранится лимбами по 9 десятичных цифр (основание 10^9),
+    // от младшего к старшему. Младшие fraction_limbs() лимбов - дробная часть,
+    // выровненная по точке: старший из них содержит первые 9 цифр после точки,
+    // а цифры младшего лимба за пределами precision всегда нулевые.
+    // Остальные лимбы - целая часть без ведущих нулевых лимбов.
+    static constexpr uint32_t BASE = bcd_limbs::BASE;
+    static constexpr int BASE_DIGITS = bcd_limbs::BASE_DIGITS;
+    
+    bcd_limbs::Limbs limbs;
+    int precision = 0;
+    
+    static int limbs_for(int digits) {
+        return (digits + BASE_DIGITS - 1) / BASE_DIGITS;
+    }
+    
+    static uint32_t pow10(int k) {
+        static const uint32_t table[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+        return table[k];
+    }
+    
+    size_t fraction_limbs() const {
+        return limbs_for(precision);
+    }
+    
+    size_t integer_limbs() const {
+        return limbs.size() - fraction_limbs();
+    }
+    
+    static bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+    
+    // Разбирает [-]цифры[(.|,)цифры] с начала [first, last) и возвращает указатель
+    // за последним разобранным символом. Лимбы переиспользуют буфер *this
+    const char* parse(const char* first, const char* last) {
+        const char* p = first;
+        is_negative = p != last && *p == '-';
+        if (is_negative) p++;
+        const char* integer = p;
+        while (p != last && is_digit(*p)) p++;
+        std::string_view integer_part(integer, p - integer);
+        std::string_view fraction_part;
+        if (p != last && (*p == '.' || *p == ',')) {
+            const char* fraction = ++p;
+            while (p != last && is_digit(*p)) p++;
+            fraction_part = std::string_view(fraction, p - fraction);
+        }
+        store_digits(integer_part, fraction_part);
+        is_negative = is_negative && !is_zero();
+        return p;
+    }
+    
+    // Разбор строк цифр целой и дробной частей в лимбы
+    void assign_digits(std::string_view integer, std::string_view fraction) {
+        if (!std::all_of(integer.begin(), integer.end(), is_digit) || !std::all_of(fraction.begin(), fraction.end(), is_digit)) {
+            throw std::invalid_argument("BCD: invalid digit");
+        }
+        store_digits(integer, fraction);
+    }
+    
+    // Значение не более 9 цифр
+    static uint32_t parse_limb(const char* digits, size_t count) {
+        uint32_t limb = 0;
+        for (size_t i = 0; i < count; i++) {
+            limb = limb * 10 + (digits[i] - '0');
+        }
+        return limb;
+    }
+    
+    // Цифры уже проверены. Лимбы пишутся в один буфер итогового размера группами
+    // по 9 цифр: дробные от точки, неполная последняя группа дополняется нулями
+    // справа; целые - с конца строки
+    void store_digits(std::string_view integer, std::string_view fraction) {
+        precision = fraction.length();
+        size_t frac = fraction_limbs();
+        limbs.resize(frac + (integer.length() + BASE_DIGITS - 1) / BASE_DIGITS);
+        uint32_t* out = limbs.data() + frac;
+        for (size_t begin = 0; begin < fraction.length(); begin += BASE_DIGITS) {
+            size_t count = std::min<size_t>(BASE_DIGITS, fraction.length() - begin);
+            *--out = parse_limb(fraction.data() + begin, count) * pow10(BASE_DIGITS - count);
+        }
+        out = limbs.data() + frac;
+        for (size_t end = integer.length(); end > 0; out++) {
+            size_t begin = end >= static_cast<size_t>(BASE_DIGITS) ? end - BASE_DIGITS : 0;
+            *out = parse_limb(integer.data() + begin, end - begin);
+            end = begin;
+        }
+        trim_integer();
+    }
+    
+    // Целая часть из машинного числа; вызывается, пока целых лимбов нет
+    void append_integer(uint64_t magnitude) {
+        for (; magnitude != 0; magnitude /= BASE) {
+            limbs.push_back(static_cast<uint32_t>(magnitude % BASE));
+        }
+    }
+    
+    // Обнуляем цифры младшего лимба, выходящие за точность
+    void clear_tail() {
+        int rest = precision % BASE_DIGITS;
+        if (rest != 0) {
+            uint32_t unit = pow10(BASE_DIGITS - rest);
+            limbs[0] -= limbs[0] % unit;
+        }
+    }
+    
+    void trim_integer() {
+        size_t frac = fraction_limbs();
+        while (limbs.size() > frac && limbs.back() == 0) {
+            limbs.pop_back();
+        }
+    }
+    
+    // Ровно 9 цифр лимба с ведущими нулями, по две цифры за шаг из таблицы
+    static void write_limb(char* out, uint32_t limb) {
+        static constexpr std::array<char, 200> PAIRS = [] {
+            std::array<char, 200> pairs{};
+            for (int i = 0; i < 100; i++) {
+                pairs[2 * i] = static_cast<char>('0' + i / 10);
+                pairs[2 * i + 1] = static_cast<char>('0' + i % 10);
+            }
+            return pairs;
+        }();
+        for (int k = BASE_DIGITS - 2; k > 0; k -= 2, limb /= 100) {
+            std::memcpy(out + k, &PAIRS[2 * (limb % 100)], 2);
+        }
+        out[0] = static_cast<char>('0' + limb);
+    }
+    
+    // Вывод числа по формату: сколько знаков сохраняется, нужно ли округление
+    // вверх и куда доходит перенос. Лимбы ниже low отброшены, лимб low усечён
+    // до кратного unit и при round_up увеличен на unit; перенос обнуляет лимбы
+    // до carry_to и прибавляет 1 к нему (carry_to за старшим - новый лимб 1)
+    struct FormatPlan {
+        const BCD& value;
+        int precision;
+        int kept;
+        size_t low;
+        uint32_t unit;
+        bool round_up = false;
+        size_t carry_to = 0;
+        size_t top_limbs;
+        int top_digits = 0;
+        bool negative;
+        char group_separator;
+        int group_size;
+        size_t integer_chars;
+        size_t length;
+        
+        FormatPlan(const BCD& value, const BCDFormat& format) : value(value) {
+            precision = format.precision < 0 ? value.precision : format.precision;
+            kept = std::min(precision, value.precision);
+            size_t frac = value.fraction_limbs();
+            size_t n = value.limbs.size();
+            low = frac - limbs_for(kept);
+            unit = kept % BASE_DIGITS == 0 ? 1 : pow10(BASE_DIGITS - kept % BASE_DIGITS);
+            const uint32_t* limbs = value.limbs.data();
+            uint32_t truncated = low < n ? limbs[low] - limbs[low] % unit : 0;
+            if (kept < value.precision) {
+                decide_rounding(format.rounding, truncated);
+            }
+            top_limbs = round_up && carry_to == n ? n + 1 : n;
+            
+            const bcd_limbs::LimbKernels& kernels = bcd_limbs::kernels();
+            bool nonzero = round_up || truncated != 0 || (low + 1 < n && !kernels.is_zero_n(limbs + low + 1, n - low - 1));
+            negative = value.is_negative && nonzero;
+            group_separator = format.group_size > 0 ? format.group_separator : 0;
+            group_size = format.group_size;
+            size_t digits = 1;
+            if (top_limbs > frac) {
+                for (uint32_t top = limb(top_limbs - 1); top != 0; top /= 10) top_digits++;
+                digits = (top_limbs - frac - 1) * BASE_DIGITS + top_digits;
+            }
+            integer_chars = digits + (group_separator ? (digits - 1) / group_size : 0);
+            length = negative + integer_chars + (precision > 0 ? 1 + precision : 0);
+        }
+        
+        // Лимб i >= low округлённого модуля
+        uint32_t limb(size_t i) const {
+            uint32_t original = i < value.limbs.size() ? value.limbs[i] : 0;
+            if (i == low) original -= original % unit;
+            if (!round_up || i < low || i > carry_to) return original;
+            if (i == carry_to) return i == low ? original + unit : original + 1;
+            return 0;
+        }
+        
+        // Отбрасываемые цифры сравниваются с половиной единицы последнего знака
+        void decide_rounding(BCDRounding rounding, uint32_t truncated) {
+            const uint32_t* limbs = value.limbs.data();
+            const bcd_limbs::LimbKernels& kernels = bcd_limbs::kernels();
+            size_t rest_end = unit > 1 ? low : low - 1;
+            uint32_t dropped = unit > 1 ? limbs[low] % unit : limbs[low - 1];
+            uint32_t half = unit > 1 ? unit / 2 : BASE / 2;
+            bool rest = !kernels.is_zero_n(limbs, rest_end);
+            bool above = dropped > half || (dropped == half && rest);
+            bool tie = dropped == half && !rest;
+            bool any = dropped != 0 || rest;
+            switch (rounding) {
+            case BCDRounding::Truncate:
+                break;
+            case BCDRounding::HalfUp:
+                round_up = above || tie;
+                break;
+            case BCDRounding::HalfEven:
+                round_up = above || (tie && (truncated / unit) % 2 == 1);
+                break;
+            case BCDRounding::Ceiling:
+                round_up = any && !value.is_negative;
+                break;
+            case BCDRounding::Floor:
+                round_up = any && value.is_negative;
+                break;
+            }
+            if (!round_up) return;
+            carry_to = low;
+            if (truncated + unit == BASE) {
+                carry_to++;
+                while (carry_to < value.limbs.size() && value.limbs[carry_to] == BASE - 1) carry_to++;
+            }
+        }
+    };
+    
+    // Лимбы в основании, дробных хватает на точность, цифры за точностью
+    // нулевые, целая часть без ведущих нулей, у нуля нет знака
+    bool is_canonical() const {
+        size_t frac = fraction_limbs();
+        if (limbs.size() < frac) return false;
+        if (std::any_of(limbs.begin(), limbs.end(), [](uint32_t limb) { return limb >= BASE; })) return false;
+        int rest = precision % BASE_DIGITS;
+        if (rest != 0 && limbs[0] % pow10(BASE_DIGITS - rest) != 0) return false;
+        if (limbs.size() > frac && limbs.back() == 0) return false;
+        return !is_negative || !is_zero();
+    }
+    
+    bool is_zero_fractional() const {
+        return bcd_limbs::kernels().is_zero_n(limbs.data(), fraction_limbs());
+    }
+    
+    // Целая часть, при round_away увеличенная по модулю на 1
+    BCD integer_rounded(bool round_away) const {
+        BCD result;
+        result.limbs.assign(limbs.begin() + fraction_limbs(), limbs.end());
+        if (round_away) {
+            size_t i = 0;
+            for (; i < result.limbs.size() && result.limbs[i] == BASE - 1; i++) {
+                result.limbs[i] = 0;
+            }
+            if (i == result.limbs.size()) {
+                result.limbs.push_back(1);
+            } else {
+                result.limbs[i]++;
+            }
+        }
+        result.is_negative = is_negative && !result.is_zero();
+        return result;
+    }
+    
+    //Сравнение модулей без выравнивания копий: общая старшая часть сравнивается
+    //векторно, лишние младшие дробные лимбы одного из чисел проверяются на ноль
+    static int compare_magnitudes(const BCD& a, const BCD& b) {
+        size_t a_int = a.integer_limbs();
+        size_t b_int = b.integer_limbs();
+        if (a_int != b_int) return a_int < b_int ? -1 : 1;
+        const bcd_limbs::LimbKernels& kernels = bcd_limbs::kernels();
+        size_t a_frac = a.fraction_limbs();
+        size_t b_frac = b.fraction_limbs();
+        size_t common = std::min(a_frac, b_frac);
+        int cmp = kernels.compare_n(a.limbs.data() + (a_frac - common), b.limbs.data() + (b_frac - common), a_int + common);
+        if (cmp != 0) return cmp;
+        if (a_frac > b_frac) return kernels.is_zero_n(a.limbs.data(), a_frac - common) ? 0 : 1;
+        if (b_frac > a_frac) return kernels.is_zero_n(b.limbs.data(), b_frac - common) ? 0 : -1;
+        return 0;
+    }
+    
+    // Ключ сортировки: лимбы числа от старшего, для отрицательных - дополнения
+    // до BASE - 1, чтобы больший модуль шёл раньше
+    struct SortKey {
+        const uint32_t* top;
+        size_t length;
+        bool negative;
+        size_t index;
+        
+        // Часть part (0..2) лимба depth; за младшим лимбом - нули
+        uint32_t digit(size_t depth, int part) const {
+            uint32_t limb = depth < length ? top[-1 - static_cast<std::ptrdiff_t>(depth)] : 0;
+            if (negative) limb = BASE - 1 - limb;
+            return (limb >> (20 - 10 * part)) & 1023;
+        }
+    };
+    
+    // Отрезки [0, count) копятся в своих аккумуляторах и складываются под
+    // мьютексом: сумма точная, поэтому порядок не важен
+    template <typename F>
+    static BCD accumulate_parallel(size_t count, F&& step);
+    
+    // Предел числа целых цифр у e^x (и у pow через exp): ряд для 100000 цифр
+    // идёт секунды, а 10^8 не дождаться. Точная целая степень ограничена
+    // числом значащих лимбов и считается умножениями за секунду и при 2^20 лимбах
+    static constexpr int MAX_EXP_DIGITS = 100000;
+    static constexpr unsigned long long MAX_EXACT_POWER_LIMBS = 1 << 20;
+    
+    // Дробные лимбы вычисления с запасом для precision знаков результата
+    static size_t working_limbs(int precision) {
+        return limbs_for(std::max(precision, 0)) + bcd_elementary::GUARD_LIMBS;
+    }
+    
+    // Модуль x со знаком в единицах BASE^-frac, младшие цифры усекаются
+    static bcd_limbs::SignedLimbs to_fixed(const BCD& x, size_t frac) {
+        bcd_limbs::SignedLimbs result;
+        result.mag = x.limbs;
+        size_t own = x.fraction_limbs();
+        if (frac >= own) {
+            bcd_limbs::shift_up(result.mag, frac - own);
+        } else {
+            bcd_limbs::shift_down(result.mag, own - frac);
+        }
+        bcd_limbs::trim(result.mag);
+        result.negative = x.is_negative && !result.mag.empty();
+        return result;
+    }
+    
+    // Число value * BASE^-frac, усечённое до precision знаков; frac < 0 - целое
+    // с -frac нулевыми младшими лимбами
+    static BCD from_fixed(bcd_limbs::SignedLimbs value, long long frac, int precision) {
+        if (precision < 0) precision = 0;
+        BCD result;
+        result.limbs = std::move(value.mag);
+        long long shift = static_cast<long long>(limbs_for(precision)) - frac;
+        if (shift >= 0) {
+            bcd_limbs::shift_up(result.limbs, shift);
+        } else {
+            bcd_limbs::shift_down(result.limbs, -shift);
+        }
+        result.finish_quotient(precision, value.negative);
+        return result;
+    }
+    
+    // Копия x с precision знаками после точки
+    static BCD widened(const BCD& x, int precision) {
+        BCD result = x;
+        result.set_precision(std::max(precision, x.get_precision()));
+        return result;
+    }
+    
+    // Целая часть |x| < 10^18
+    long long integer_part() const {
+        long long result = 0;
+        for (size_t i = limbs.size(); i-- > fraction_limbs();) {
+            result = result * BASE + limbs[i];
+        }
+        return result;
+    }
+    
+    // sin и cos с точностью fp: x приводится к r = x - q pi / 2, |r| <= pi / 4,
+    // и четверть q mod 4 переставляет и меняет знаки sin r и cos r.
+    // pi берётся точнее на число целых лимбов x
+    static std::pair<bcd_limbs::SignedLimbs, bcd_limbs::SignedLimbs> sin_cos(const BCD& x, const bcd_elementary::FixedPoint& fp) {
+        using bcd_elementary::FixedPoint;
+        FixedPoint wide(fp.fraction() + x.integer_limbs() + 1);
+        bcd_limbs::SignedLimbs value = to_fixed(x, wide.fraction());
+        bcd_limbs::SignedLimbs half_pi = FixedPoint::div_word(bcd_elementary::pi(wide), 2);
+        bcd_limbs::SignedLimbs quarter;
+        quarter.mag = wide.nearest_integer(FixedPoint::absolute(wide.div(value, half_pi)));
+        quarter.negative = value.negative && !quarter.mag.empty();
+        unsigned q = quarter.mag.empty() ? 0 : quarter.mag[0] % 4;
+        if (quarter.negative) q = (4 - q) % 4;
+        
+        bcd_limbs::SignedLimbs reduced = bcd_limbs::signed_sub(value, bcd_limbs::signed_mul(quarter, half_pi));
+        auto [sine, cosine] = bcd_elementary::sin_cos(fp, fp.rescale(reduced, wide.fraction()));
+        switch (q) {
+        case 1:
+            return {cosine, FixedPoint::negated(sine)};
+        case 2:
+            return {FixedPoint::negated(sine), FixedPoint::negated(cosine)};
+        case 3:
+            return {FixedPoint::negated(cosine), sine};
+        default:
+            return {sine, cosine};
+        }
+    }
+    
+    // tan = sin / cos или cot = cos / sin. Малый знаменатель с z нулевыми
+    // лимбами после точки теряет z лимбов относительной точности, а частное
+    // получает z целых лимбов, поэтому при нехватке точность поднимается на 2z
+    static BCD trigonometric_ratio(const BCD& x, int precision, bool inverse) {
+        size_t needed = working_limbs(precision);
+        for (size_t frac = needed; ;) {
+            bcd_elementary::FixedPoint fp(frac);
+            auto [sine, cosine] = sin_cos(x, fp);
+            const bcd_limbs::SignedLimbs& denominator = inverse ? sine : cosine;
+            size_t zeros = frac - std::min(frac, denominator.mag.size());
+            if (!denominator.mag.empty() && denominator.mag.size() >= needed + zeros) {
+                return from_fixed(fp.div(inverse ? cosine : sine, denominator), fp.fraction(), precision);
+            }
+            frac = needed + 2 * zeros + bcd_elementary::GUARD_LIMBS;
+        }
+    }
+    
+    // x^n и x^-n: произведение лимбов точное. Нулевые младшие лимбы x (их z)
+    // отбрасываются, и у x^n остаётся n * (f - z) дробных лимбов - при z > f
+    // это целое с нулевыми младшими лимбами
+    static BCD integer_power(const BCD& x, uint32_t n, bool inverse, int precision) {
+        size_t zeros = x.low_zero_limbs();
+        bcd_limbs::Limbs base(x.limbs.begin() + zeros, x.limbs.end());
+        bcd_limbs::Limbs power(1, 1);
+        for (uint32_t bit = n; bit != 0; bit >>= 1) {
+            if (bit & 1) power = bcd_limbs::product(power, base);
+            if (bit > 1) base = bcd_limbs::product(base, base);
+        }
+        bcd_limbs::SignedLimbs value;
+        value.mag = std::move(power);
+        value.negative = x.is_negative && n % 2 == 1 && !value.mag.empty();
+        long long frac = (static_cast<long long>(x.fraction_limbs()) - static_cast<long long>(zeros)) * n;
+        if (!inverse) {
+            return from_fixed(std::move(value), frac, precision);
+        }
+        BCD exact = from_fixed(std::move(value), frac, static_cast<int>(std::clamp<long long>(frac * BASE_DIGITS, 0, INT32_MAX)));
+        return BCD(1).divide(exact, precision);
+    }
+    
+    // Число нулевых лимбов снизу (у нуля - все)
+    size_t low_zero_limbs() const {
+        size_t zeros = 0;
+        while (zeros < limbs.size() && limbs[zeros] == 0) zeros++;
+        return zeros;
+    }
+    
+    // Частное или корень как целое в единицах BASE^-F: дополняем дробные лимбы
+    // нулями и обрезаем цифры за точностью
+    void finish_quotient(int new_precision, bool negative) {
+        precision = new_precision;
+        if (limbs.size() < fraction_limbs()) {
+            limbs.resize(fraction_limbs(), 0);
+        }
+        clear_tail();
+        is_negative = negative && !is_zero();
+    }
+    
+    // Отбрасываем младшие лимбы сверх новой точности и нормализуем результат
+    void finish_sum(size_t frac_len, int new_precision) {
+        size_t drop = frac_len - limbs_for(new_precision);
+        limbs.erase(limbs.begin(), limbs.begin() + drop);
+        precision = new_precision;
+        clear_tail();
+        trim_integer();
+    }
+    
+    // Буфер потока для составных операторов
+    static bcd_limbs::Limbs& scratch_limbs() {
+        static thread_local bcd_limbs::Limbs buffer;
+        return buffer;
+    }
+    
+    // compute(result) пишет результат в BCD с лимбами буфера потока, затем лимбы
+    // *this становятся новым буфером. compute может читать *this, но не result
+    template <typename F>
+    BCD& assign_in_place(F&& compute) {
+        BCD result;
+        result.limbs.swap(scratch_limbs());
+        compute(result);
+        limbs.swap(scratch_limbs());
+        limbs.swap(result.limbs);
+        precision = result.precision;
+        is_negative = result.is_negative;
+        return *this;
+    }
+    
+    // Знак -x; у нуля знак не меняется, как в унарном минусе
+    static bool negated_sign(const BCD& x) {
+        return x.is_zero() ? x.is_negative : !x.is_negative;
+    }
+    
+    // Ноль точности 0, как BCD(0, ""), с сохранением буфера
+    void assign_zero() {
+        limbs.clear();
+        precision = 0;
+        is_negative = false;
+    }
+    
+    // a + b, где у b знак b_negative; result не должен совпадать с операндами
+    static void add_into(const BCD& a, const BCD& b, bool b_negative, BCD& result) {
+        if (a.is_negative == b_negative) {
+            add_same_sign(a, b, result);
+        } else {
+            add_different_sign(a, b, b_negative, result);
+        }
+    }
+    
+    // Лимбы - это модули чисел как целых, поэтому перемножаем их напрямую
+    static void multiply_into(const BCD& a, const BCD& b, BCD& result) {
+        if (a.is_zero() || b.is_zero()) {
+            result.assign_zero();
+            return;
+        }
+        
+        bool result_negative = (a.is_negative != b.is_negative);
+        
+        // Вычисляем новую точность по числу цифр большей целой части
+        int log_term = std::max(a.integer_digits(), b.integer_digits());
+        int new_precision = std::min(a.get_precision(), b.get_precision()) - (1 + log_term);
+        if (new_precision < 0) new_precision = 0;
+        
+        // Младшие a.fraction_limbs() + b.fraction_limbs() лимбов произведения - дробные,
+        // из них нужны только limbs_for(new_precision): остальные не считаем
+        size_t drop = a.fraction_limbs() + b.fraction_limbs() - limbs_for(new_precision);
+        size_t length = a.limbs.size() + b.limbs.size();
+        result.limbs.resize(length - drop);
+        if (drop == 0) {
+            bcd_limbs::multiply(a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size(), result.limbs.data());
+        } else {
+            bcd_limbs::multiply_high(a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size(), drop, result.limbs.data());
+        }
+        result.precision = new_precision;
+        result.clear_tail();
+        result.trim_integer();
+        result.is_negative = result_negative && !result.is_zero();
+    }
+    
+    // |a| / |b| = A * BASE^-fa / (B * BASE^-fb), где A и B - лимбы как целые.
+    // Нужно floor(A * BASE^(fb + F) / (B * BASE^fa)), F - число дробных лимбов частного;
+    // нулевые младшие лимбы делителя сокращаем сразу
+    static void divide_into(const BCD& a, const BCD& b, int precision, BCD& result) {
+        if (b.is_zero()) {
+            throw std::runtime_error("BCD: division by zero");
+        }
+        if (precision < 0) precision = 0;
+        
+        size_t zeros = 0;
+        while (b.limbs[zeros] == 0) zeros++;
+        const uint32_t* divisor = b.limbs.data() + zeros;
+        size_t divisor_len = bcd_limbs::significant_length(divisor, b.limbs.size() - zeros);
+        size_t dividend_len = bcd_limbs::significant_length(a.limbs.data(), a.limbs.size());
+        long long shift = static_cast<long long>(b.fraction_limbs()) + limbs_for(precision)
+                        - static_cast<long long>(a.fraction_limbs()) - static_cast<long long>(zeros);
+        
+        unsigned __int128 word = 0;
+        if (divisor_len <= 3) {
+            for (size_t i = divisor_len; i-- > 0;) word = word * BASE + divisor[i];
+        }
+        if (divisor_len <= 3 && word <= UINT64_MAX) {
+            // Делитель - машинное слово: сдвинутое делимое собирается прямо в result
+            // и делится на месте
+            size_t skip = shift < 0 ? std::min<size_t>(-shift, dividend_len) : 0;
+            size_t pad = shift > 0 && dividend_len > 0 ? shift : 0;
+            result.limbs.assign(pad + dividend_len - skip, 0);
+            std::copy(a.limbs.begin() + skip, a.limbs.begin() + dividend_len, result.limbs.begin() + pad);
+            bcd_limbs::divide_by_word(result.limbs, static_cast<uint64_t>(word));
+        } else {
+            bcd_limbs::Limbs dividend(a.limbs.begin(), a.limbs.begin() + dividend_len);
+            if (shift >= 0) {
+                bcd_limbs::shift_up(dividend, shift);
+            } else {
+                bcd_limbs::shift_down(dividend, -shift);
+            }
+            result.limbs = bcd_limbs::divide(std::move(dividend), bcd_limbs::Limbs(divisor, divisor + divisor_len));
+        }
+        result.finish_quotient(precision, a.is_negative != b.is_negative);
+    }
+    
+    //2 Метода для сложения чисел. Операнды выравниваются по точке: у числа с более
+    //короткой дробью не хватает shift младших лимбов, там складывать не с чем
+    static void add_same_sign(const BCD& a, const BCD& b, BCD& result) {
+        int new_precision = std::min(a.get_precision(), b.get_precision()) - 1;
+        if (new_precision < 0) new_precision = 0;
+        
+        const BCD& finer = a.fraction_limbs() >= b.fraction_limbs() ? a : b;
+        const BCD& coarser = &finer == &a ? b : a;
+        size_t shift = finer.fraction_limbs() - coarser.fraction_limbs();
+        size_t finer_end = finer.limbs.size();
+        size_t coarser_end = shift + coarser.limbs.size();
+        size_t both_end = std::min(finer_end, coarser_end);
+        size_t len = std::max(finer_end, coarser_end);
+        
+        result.limbs.resize(len + 1);
+        uint32_t* out = result.limbs.data();
+        std::copy(finer.limbs.begin(), finer.limbs.begin() + shift, out);
+        uint32_t carry = bcd_limbs::kernels().add_n(finer.limbs.data() + shift, coarser.limbs.data(),
+                                                    out + shift, both_end - shift, 0);
+        if (finer_end > coarser_end) {
+            carry = bcd_limbs::add_carry_n(finer.limbs.data() + both_end, out + both_end, len - both_end, carry);
+        } else {
+            carry = bcd_limbs::add_carry_n(coarser.limbs.data() + (both_end - shift), out + both_end, len - both_end, carry);
+        }
+        out[len] = carry;
+        
+        result.finish_sum(finer.fraction_limbs(), new_precision);
+        result.is_negative = a.is_negative;
+    }
+    
+    static void add_different_sign(const BCD& a, const BCD& b, bool b_negative, BCD& result) {
+        // Определяем число с большим абсолютным значением
+        int cmp = compare_magnitudes(a, b);
+        
+        if (cmp == 0) {
+            result.assign_zero();
+            return;
+        }
+        
+        const BCD& larger = cmp > 0 ? a : b;
+        const BCD& smaller = cmp > 0 ? b : a;
+        
+        // Вычисляем новую точность
+        int new_precision = std::min(a.get_precision(), b.get_precision()) - 1;
+        if (new_precision < 0) new_precision = 0;
+        
+        size_t frac_len = std::max(a.fraction_limbs(), b.fraction_limbs());
+        size_t larger_shift = frac_len - larger.fraction_limbs();
+        size_t smaller_shift = frac_len - smaller.fraction_limbs();
+        size_t larger_end = larger_shift + larger.limbs.size();
+        size_t smaller_end = smaller_shift + smaller.limbs.size();
+        
+        result.limbs.resize(larger_end);
+        uint32_t* out = result.limbs.data();
+        uint32_t borrow = 0;
+        
+        // Младшие лимбы, которые есть только у одного из чисел
+        if (larger_shift == 0) {
+            std::copy(larger.limbs.begin(), larger.limbs.begin() + smaller_shift, out);
+        } else {
+            borrow = bcd_limbs::negate_n(smaller.limbs.data(), out, larger_shift);
+        }
+        size_t start = std::max(larger_shift, smaller_shift);
+        borrow = bcd_limbs::kernels().sub_n(larger.limbs.data() + (start - larger_shift), smaller.limbs.data() + (start - smaller_shift),
+                                            out + start, smaller_end - start, borrow);
+        bcd_limbs::sub_borrow_n(larger.limbs.data() + (smaller_end - larger_shift), out + smaller_end, larger_end - smaller_end, borrow);
+        
+        result.finish_sum(frac_len, new_precision);
+        result.is_negative = cmp > 0 ? a.is_negative : b_negative;
+    }
+};
+
+// Точная сумма чисел и произведений BCD без нормализации после каждого слагаемого.
+// Лимбы слагаемых складываются в 64-битные столбцы, выровненные по точке, а
+// переносы разносятся один раз на блок: когда столбец может переполниться
+// и при чтении результата. Положительные и отрицательные слагаемые копятся
+// отдельно, и вычитание одно - в result(). Точность не падает, как у
+// operator+: результат имеет наибольшую точность слагаемых
+class BCDAccumulator {
+public:
+    void add(const BCD& x) {
+        align(x.fraction_limbs(), x.precision);
+        std::vector<uint64_t>& target = columns(x.is_negative);
+        reserve(1);
+        size_t offset = frac - x.fraction_limbs();
+        if (target.size() < offset + x.limbs.size()) {
+            target.resize(offset + x.limbs.size(), 0);
+        }
+        uint64_t* out = target.data() + offset;
+        for (size_t i = 0; i < x.limbs.size(); i++) {
+            out[i] += x.limbs[i];
+        }
+    }
+    
+    void subtract(const BCD& x) {
+        add(-x);
+    }
+    
+    // a * b: у произведения fa + fb дробных лимбов и pa + pb знаков.
+    // Короткие множители перемножаются столбиком прямо в столбцы: каждое
+    // произведение лимбов p < BASE^2 даёт p mod BASE и p div BASE, а
+    // длинные - быстрым умножением bcd_limbs
+    void add_product(const BCD& a, const BCD& b) {
+        size_t product_frac = a.fraction_limbs() + b.fraction_limbs();
+        align(product_frac, a.precision + b.precision);
+        std::vector<uint64_t>& target = columns(a.is_negative != b.is_negative);
+        size_t n = a.limbs.size();
+        size_t m = b.limbs.size();
+        if (n == 0 || m == 0) return;
+        size_t offset = frac - product_frac;
+        if (target.size() < offset + n + m) {
+            target.resize(offset + n + m, 0);
+        }
+        if (std::min(n, m) < bcd_limbs::mul_thresholds.karatsuba) {
+            // В столбец попадает не больше 2 min(n, m) слагаемых меньше BASE
+            reserve(2 * std::min(n, m));
+            uint64_t* out = target.data() + offset;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t x = a.limbs[i];
+                for (size_t j = 0; j < m; j++) {
+                    uint64_t p = x * b.limbs[j];
+                    out[i + j] += p % bcd_limbs::BASE;
+                    out[i + j + 1] += p / bcd_limbs::BASE;
+                }
+            }
+        } else {
+            reserve(1);
+            bcd_limbs::Limbs product(n + m);
+            bcd_limbs::multiply(a.limbs.data(), n, b.limbs.data(), m, product.data());
+            for (size_t i = 0; i < product.size(); i++) {
+                target[offset + i] += product[i];
+            }
+        }
+    }
+    
+    // Частичная сумма другого аккумулятора, например посчитанная в другом потоке
+    void add(const BCDAccumulator& other) {
+        add(other.result());
+    }
+    
+    BCD result() const {
+        bcd_limbs::SignedLimbs total = bcd_limbs::signed_sub(normalized(positive), normalized(negative));
+        return BCD::from_fixed(std::move(total), static_cast<long long>(frac), precision);
+    }
+    
+    void clear() {
+        positive.clear();
+        negative.clear();
+        frac = 0;
+        precision = 0;
+        pending = 0;
+    }
+    
+private:
+    // Столбец не переполнится, пока в него добавлено не больше LIMIT слагаемых
+    // меньше BASE: LIMIT * BASE + перенос < 2^64
+    static constexpr uint64_t LIMIT = UINT64_MAX / bcd_limbs::BASE - 1;
+    
+    std::vector<uint64_t> positive;
+    std::vector<uint64_t> negative;
+    size_t frac = 0;
+    int precision = 0;
+    uint64_t pending = 0;
+    
+    std::vector<uint64_t>& columns(bool is_negative) {
+        return is_negative ? negative : positive;
+    }
+    
+    // Слагаемое с большим числом дробных лимбов сдвигает столбцы
+    void align(size_t value_frac, int value_precision) {
+        if (value_frac > frac) {
+            if (!positive.empty()) positive.insert(positive.begin(), value_frac - frac, 0);
+            if (!negative.empty()) negative.insert(negative.begin(), value_frac - frac, 0);
+            frac = value_frac;
+        }
+        precision = std::max(precision, value_precision);
+    }
+    
+    // Место под ещё count слагаемых в каждом столбце; иначе разносим переносы
+    void reserve(uint64_t count) {
+        if (pending + count > LIMIT) {
+            carry(positive);
+            carry(negative);
+            pending = 1;
+        }
+        pending += count;
+    }
+    
+    static void carry(std::vector<uint64_t>& x) {
+        uint64_t carry = 0;
+        for (uint64_t& column : x) {
+            uint64_t value = column + carry;
+            column = value % bcd_limbs::BASE;
+            carry = value / bcd_limbs::BASE;
+        }
+        for (; carry != 0; carry /= bcd_limbs::BASE) {
+            x.push_back(carry % bcd_limbs::BASE);
+        }
+    }
+    
+    static bcd_limbs::SignedLimbs normalized(std::vector<uint64_t> x) {
+        carry(x);
+        bcd_limbs::SignedLimbs result;
+        result.mag.assign(x.begin(), x.end());
+        bcd_limbs::trim(result.mag);
+        return result;
+    }
+};
+
+template <typename F>
+BCD BCD::accumulate_parallel(size_t count, F&& step) {
+    const size_t GRAIN = 1 << 14;
+    BCDAccumulator total;
+    std::mutex total_mutex;
+    bcd_parallel::parallel_for(0, count, GRAIN, [&](size_t from, size_t to) {
+        BCDAccumulator part;
+        for (size_t i = from; i < to; i++) {
+            step(part, i);
+        }
+        BCD partial = part.result();
+        std::lock_guard<std::mutex> lock(total_mutex);
+        total.add(partial);
+    });
+    return total.result();
+}
+
+inline BCD BCD::sum(const BCD* values, size_t count) {
+    return accumulate_parallel(count, [values](BCDAccumulator& accumulator, size_t i) {
+        accumulator.add(values[i]);
+    });
+}
+
+inline BCD BCD::dot(const BCD* a, const BCD* b, size_t count) {
+    return accumulate_parallel(count, [a, b](BCDAccumulator& accumulator, size_t i) {
+        accumulator.add_product(a[i], b[i]);
+    });
+}
+
+inline void BCD::sort(BCD* values, size_t count) {
+    // Отрезки короче - сортировкой сравнением
+    const size_t SMALL = 64;
+    if (count < 2) return;
+    std::vector<SortKey> keys(count);
+    std::vector<SortKey> buffer(count);
+    size_t max_integer = 0;
+    for (size_t i = 0; i < count; i++) {
+        const BCD& value = values[i];
+        keys[i] = {value.limbs.data() + value.limbs.size(), value.limbs.size(), value.is_negative, i};
+        max_integer = std::max(max_integer, value.integer_limbs());
+    }
+    
+    // Группы: отрицательные с длинной целой частью, ..., неотрицательные с длинной
+    auto group = [&](const SortKey& key) {
+        size_t integer = key.length - values[key.index].fraction_limbs();
+        return key.negative ? max_integer - integer : max_integer + 1 + integer;
+    };
+    std::vector<size_t> starts(2 * max_integer + 3, 0);
+    for (const SortKey& key : keys) starts[group(key) + 1]++;
+    for (size_t g = 1; g < starts.size(); g++) starts[g] += starts[g - 1];
+    std::vector<size_t> next(starts.begin(), starts.end() - 1);
+    for (const SortKey& key : keys) buffer[next[group(key)]++] = key;
+    keys.swap(buffer);
+    
+    // Отрезок [from, to) с общими старшими частями до digit; стек вместо
+    // рекурсии, чтобы длинные общие префиксы не углубляли вызовы
+    struct Range {
+        size_t from, to, digit;
+    };
+    std::vector<Range> ranges;
+    for (size_t g = 0; g + 1 < starts.size(); g++) {
+        if (starts[g + 1] - starts[g] > 1) ranges.push_back({starts[g], starts[g + 1], 0});
+    }
+    std::array<size_t, 1025> counts;
+    auto less = [values](const SortKey& a, const SortKey& b) {
+        return compare(values[a.index], values[b.index]) < 0;
+    };
+    while (!ranges.empty()) {
+        Range range = ranges.back();
+        ranges.pop_back();
+        if (range.to - range.from < SMALL) {
+            std::stable_sort(keys.begin() + range.from, keys.begin() + range.to, less);
+            continue;
+        }
+        for (;; range.digit++) {
+            size_t depth = range.digit / 3;
+            int part = range.digit % 3;
+            counts.fill(0);
+            bool remaining = false;
+            for (size_t i = range.from; i < range.to; i++) {
+                counts[keys[i].digit(depth, part) + 1]++;
+                remaining = remaining || keys[i].length > depth;
+            }
+            // Все лимбы просмотрены - числа отрезка равны
+            if (!remaining) break;
+            size_t size = range.to - range.from;
+            if (std::find(counts.begin(), counts.end(), size) != counts.end()) continue;
+            for (size_t d = 1; d < counts.size(); d++) counts[d] += counts[d - 1];
+            for (size_t i = range.from; i < range.to; i++) {
+                buffer[range.from + counts[keys[i].digit(depth, part)]++] = keys[i];
+            }
+            std::copy(buffer.begin() + range.from, buffer.begin() + range.to, keys.begin() + range.from);
+            // После раскладки counts[d] - конец корзины d
+            size_t begin = range.from;
+            for (size_t d = 0; d < 1024; d++) {
+                size_t end = range.from + counts[d];
+                if (end - begin > 1) ranges.push_back({begin, end, range.digit + 1});
+                begin = end;
+            }
+            break;
+        }
+    }
+    
+    std::vector<BCD> sorted;
+    sorted.reserve(count);
+    for (const SortKey& key : keys) {
+        sorted.push_back(std::move(values[key.index]));
+    }
+    std::move(sorted.begin(), sorted.end(), values);
+}
+
+// Для std::unordered_set<BCD> и группировки по значению
+namespace std {
+template <>
+struct hash<BCD> {
+    size_t operator()(const BCD& value) const {
+        return value.hash();
+    }
+};
+}
+
+// Двоичный файл столбца BCD, который читается на месте из отображённой памяти.
+// Заголовок 16 байт: "BCDB", версия формата (uint32_t) и 8 нулевых байт. Далее
+// записи BCD::to_binary подряд - их длины кратны 4, поэтому лимбы выровнены.
+// За записями индекс: смещения записей от начала файла (uint64_t, с границы
+// 8 байт), и хвост 16 байт: смещение индекса и число записей (uint64_t).
+// Порядок байтов - машинный: на машине с другим порядком версия не совпадёт
+namespace bcd_binary {
+constexpr char MAGIC[4] = {'B', 'C', 'D', 'B'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t TRAILER_SIZE = 16;
+} // namespace bcd_binary
+
+// Запись столбца в поток через буфер. Индекс и хвост пишет finish(),
+// без него файл не читается
+class BCDBinaryWriter {
+public:
+    explicit BCDBinaryWriter(std::ostream& out) : out(out) {
+        char header[bcd_binary::HEADER_SIZE] = {};
+        std::memcpy(header, bcd_binary::MAGIC, sizeof(bcd_binary::MAGIC));
+        std::memcpy(header + sizeof(bcd_binary::MAGIC), &bcd_binary::VERSION, sizeof(uint32_t));
+        buffer.reserve(BUFFER_BYTES);
+        buffer.insert(buffer.end(), header, header + sizeof(header));
+    }
+    
+    BCDBinaryWriter(const BCDBinaryWriter&) = delete;
+    BCDBinaryWriter& operator=(const BCDBinaryWriter&) = delete;
+    
+    void write(const BCD& value) {
+        size_t size = value.binary_size();
+        if (buffer.size() + size > BUFFER_BYTES) {
+            flush();
+        }
+        offsets.push_back(written + buffer.size());
+        size_t end = buffer.size();
+        buffer.resize(end + size);
+        value.to_binary(buffer.data() + end);
+    }
+    
+    void write(const BCD* values, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            write(values[i]);
+        }
+    }
+    
+    void finish() {
+        size_t unaligned = (written + buffer.size()) % sizeof(uint64_t);
+        if (unaligned != 0) {
+            buffer.resize(buffer.size() + sizeof(uint64_t) - unaligned, 0);
+        }
+        uint64_t trailer[2] = {written + buffer.size(), offsets.size()};
+        const char* index = reinterpret_cast<const char*>(offsets.data());
+        buffer.insert(buffer.end(), index, index + offsets.size() * sizeof(uint64_t));
+        buffer.insert(buffer.end(), reinterpret_cast<const char*>(trailer), reinterpret_cast<const char*>(trailer) + sizeof(trailer));
+        flush();
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("BCD: binary column write failed");
+        }
+    }
+    
+private:
+    static constexpr size_t BUFFER_BYTES = 1 << 20;
+    
+    std::ostream& out;
+    std::vector<char> buffer;
+    std::vector<uint64_t> offsets;
+    uint64_t written = 0;
+    
+    void flush() {
+        out.write(buffer.data(), buffer.size());
+        written += buffer.size();
+        buffer.clear();
+    }
+};
+
+// Чтение столбца из памяти (обычно отображённого файла), выровненной на 4 байта.
+// Заголовок, хвост и границы индекса проверяются при открытии, смещение
+// записи - при обращении к ней. Буфер должен жить, пока живёт читатель
+class BCDBinaryReader {
+public:
+    // Запись на месте: limbs указывает прямо в буфер, цифры не проверяются
+    struct Record {
+        const uint32_t* limbs;
+        size_t length;
+        int precision;
+        bool negative;
+    };
+    
+    BCDBinaryReader(const char* data, size_t size) : data(data) {
+        uint32_t version = 0;
+        if (size < bcd_binary::HEADER_SIZE + bcd_binary::TRAILER_SIZE || reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0
+            || std::memcmp(data, bcd_binary::MAGIC, sizeof(bcd_binary::MAGIC)) != 0) {
+            throw std::runtime_error("BCD: not a binary column");
+        }
+        std::memcpy(&version, data + sizeof(bcd_binary::MAGIC), sizeof(version));
+        if (version != bcd_binary::VERSION) {
+            throw std::runtime_error("BCD: unsupported binary column version " + std::to_string(version));
+        }
+        uint64_t trailer[2];
+        std::memcpy(trailer, data + size - bcd_binary::TRAILER_SIZE, sizeof(trailer));
+        index_offset = trailer[0];
+        count = trailer[1];
+        uint64_t index_end = size - bcd_binary::TRAILER_SIZE;
+        if (index_offset < bcd_binary::HEADER_SIZE || index_offset > index_end
+            || (index_end - index_offset) / sizeof(uint64_t) != count || (index_end - index_offset) % sizeof(uint64_t) != 0) {
+            throw std::runtime_error("BCD: corrupt binary column index");
+        }
+    }
+    
+    size_t size() const {
+        return count;
+    }
+    
+    Record record(size_t i) const {
+        uint64_t begin = offset(i);
+        uint32_t header[2];
+        std::memcpy(header, data + begin, sizeof(header));
+        if ((index_offset - begin - sizeof(header)) / sizeof(uint32_t) < header[0]
+            || (header[1] & 0x7FFFFFFF) > BCD::MAX_BINARY_PRECISION) {
+            throw std::runtime_error("BCD: corrupt binary column record " + std::to_string(i));
+        }
+        return {reinterpret_cast<const uint32_t*>(data + begin + sizeof(header)), header[0],
+                static_cast<int>(header[1] & 0x7FFFFFFF), (header[1] >> 31) != 0};
+    }
+    
+    // Копия записи с полной проверкой
+    BCD operator[](size_t i) const {
+        BCD value;
+        if (from_binary(data + offset(i), data + index_offset, value).ec != std::errc()) {
+            throw std::runtime_error("BCD: corrupt binary column record " + std::to_string(i));
+        }
+        return value;
+    }
+    
+    // Весь столбец; при включённом пуле потоков записи копируются параллельно
+    std::vector<BCD> load() const {
+        const size_t GRAIN = 1 << 12;
+        std::vector<BCD> column(count);
+        bcd_parallel::parallel_for(0, count, GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; i++) {
+                column[i] = (*this)[i];
+            }
+        });
+        return column;
+    }
+    
+private:
+    const char* data;
+    uint64_t index_offset = 0;
+    size_t count = 0;
+    
+    // Смещение записи i: за заголовком, до индекса, кратно 4, со словами длины и точности
+    uint64_t offset(size_t i) const {
+        if (i >= count) {
+            throw std::out_of_range("BCD: binary column index out of range");
+        }
+        uint64_t begin;
+        std::memcpy(&begin, data + index_offset + i * sizeof(uint64_t), sizeof(begin));
+        if (begin < bcd_binary::HEADER_SIZE || begin % alignof(uint32_t) != 0 || begin > index_offset
+            || index_offset - begin < 2 * sizeof(uint32_t)) {
+            throw std::runtime_error("BCD: corrupt binary column record " + std::to_string(i));
+        }
+        return begin;
+    }
+};
+
+// Текстовый вывод столбца через буфер: каждое число по формату и за ним
+// separator. Числа пишутся to_chars прямо в буфер, в поток он уходит целиком
+// при заполнении и в деструкторе
+class BCDTextWriter {
+public:
+    explicit BCDTextWriter(std::ostream& out, const BCDFormat& format = {}, char separator = '\n')
+        : out(out), format(format), separator(separator), buffer(BUFFER_BYTES) {}
+    
+    ~BCDTextWriter() {
+        flush();
+    }
+    
+    BCDTextWriter(const BCDTextWriter&) = delete;
+    BCDTextWriter& operator=(const BCDTextWriter&) = delete;
+    
+    void write(const BCD& value) {
+        // Последний байт свободного места оставлен под separator
+        std::to_chars_result printed = to_chars(buffer.data() + used, buffer.data() + buffer.size() - 1, value, format);
+        if (printed.ec != std::errc()) {
+            flush();
+            buffer.resize(std::max(buffer.size(), value.formatted_size(format) + 1));
+            printed = to_chars(buffer.data(), buffer.data() + buffer.size() - 1, value, format);
+        }
+        *printed.ptr = separator;
+        used = printed.ptr + 1 - buffer.data();
+    }
+    
+    void write(const BCD* values, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            write(values[i]);
+        }
+    }
+    
+    void flush() {
+        out.write(buffer.data(), used);
+        used = 0;
+    }
+    
+private:
+    static constexpr size_t BUFFER_BYTES = 1 << 16;
+    
+    std::ostream& out;
+    BCDFormat format;
+    char separator;
+    std::vector<char> buffer;
+    size_t used = 0;
+};
+
+// Десятичное число с точностью, известной при компиляции: не более IntDigits цифр
+// целой части и ровно FracDigits знаков после точки. Лимбы лежат в std::array
+// в той же раскладке, что у BCD (основание 10^9, дробь выровнена по точке),
+// поэтому куча не нужна, а длины циклов - константы, и компилятор их разворачивает.
+// В отличие от BCD точность не падает: сумма точна, произведение усекается
+// до FracDigits знаков. Выход за IntDigits - std::overflow_error.
+template <int IntDigits, int FracDigits>
+class FixedBCD {
+    static_assert(IntDigits >= 0 && FracDigits >= 0 && IntDigits + FracDigits > 0, "FixedBCD: bad digit counts");
+    
+public:
+    constexpr FixedBCD() = default;
+    
+    constexpr FixedBCD(long long value) {
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        for (size_t i = FRAC_LIMBS; magnitude != 0; i++, magnitude /= BASE) {
+            if (i == LIMBS) throw std::overflow_error("FixedBCD: overflow");
+            limbs[i] = static_cast<uint32_t>(magnitude % BASE);
+        }
+        check_overflow();
+        is_negative = value < 0;
+    }
+    
+    // Тот же формат, что у BCD (пустая строка - ноль, иначе нужна цифра);
+    // лишние знаки после точки отбрасываются
+    constexpr explicit FixedBCD(std::string_view str) {
+        size_t p = 0;
+        bool negative = p < str.size() && str[p] == '-';
+        if (negative) p++;
+        size_t integer_begin = p;
+        while (p < str.size() && is_digit(str[p])) p++;
+        size_t integer_end = p;
+        size_t fraction_begin = p, fraction_end = p;
+        if (p < str.size() && (str[p] == '.' || str[p] == ',')) {
+            fraction_begin = ++p;
+            while (p < str.size() && is_digit(str[p])) p++;
+            fraction_end = p;
+        }
+        bool no_digits = integer_end == integer_begin && fraction_end == fraction_begin;
+        if (p != str.size() || (!str.empty() && no_digits)) {
+            throw std::invalid_argument("FixedBCD: invalid digit");
+        }
+        while (integer_begin < integer_end && str[integer_begin] == '0') integer_begin++;
+        if (integer_end - integer_begin > static_cast<size_t>(IntDigits)) {
+            throw std::overflow_error("FixedBCD: overflow");
+        }
+        size_t i = FRAC_LIMBS;
+        for (size_t end = integer_end; end > integer_begin; i++) {
+            size_t begin = end - integer_begin >= static_cast<size_t>(BASE_DIGITS) ? end - BASE_DIGITS : integer_begin;
+            limbs[i] = parse_limb(str, begin, end);
+            end = begin;
+        }
+        fraction_end = std::min(fraction_end, fraction_begin + FracDigits);
+        i = FRAC_LIMBS;
+        for (size_t begin = fraction_begin; begin < fraction_end; begin += BASE_DIGITS) {
+            size_t end = std::min(begin + BASE_DIGITS, fraction_end);
+            limbs[--i] = parse_limb(str, begin, end) * pow10(BASE_DIGITS - static_cast<int>(end - begin));
+        }
+        is_negative = negative && !is_zero();
+    }
+    
+    // Из BCD с усечением дробной части до FracDigits знаков
+    explicit FixedBCD(const BCD& value) {
+        size_t source_frac = value.fraction_limbs();
+        for (size_t i = 0; i < value.limbs.size(); i++) {
+            // Лимб i источника стоит на месте i - source_frac + FRAC_LIMBS
+            long long target = static_cast<long long>(i) - static_cast<long long>(source_frac) + static_cast<long long>(FRAC_LIMBS);
+            if (target < 0) continue;
+            if (target >= static_cast<long long>(LIMBS)) {
+                if (value.limbs[i] != 0) throw std::overflow_error("FixedBCD: overflow");
+                continue;
+            }
+            limbs[target] = value.limbs[i];
+        }
+        clear_tail();
+        check_overflow();
+        is_negative = value.is_negative && !is_zero();
+    }
+    
+    // BCD с precision FracDigits
+    BCD to_bcd() const {
+        BCD result;
+        result.limbs.assign(limbs.begin(), limbs.end());
+        result.precision = FracDigits;
+        result.trim_integer();
+        result.is_negative = is_negative;
+        return result;
+    }
+    
+    constexpr bool is_zero() const {
+        for (size_t i = 0; i < LIMBS; i++) {
+            if (limbs[i] != 0) return false;
+        }
+        return true;
+    }
+    
+    constexpr bool negative() const {
+        return is_negative;
+    }
+    
+    constexpr FixedBCD operator-() const {
+        FixedBCD result = *this;
+        result.is_negative = !is_negative && !is_zero();
+        return result;
+    }
+    
+    constexpr FixedBCD operator+() const {
+        return *this;
+    }
+    
+    constexpr FixedBCD& operator+=(const FixedBCD& other) {
+        add_signed(other, other.is_negative);
+        return *this;
+    }
+    
+    constexpr FixedBCD& operator-=(const FixedBCD& other) {
+        add_signed(other, !other.is_negative);
+        return *this;
+    }
+    
+    // Полное произведение 2 * LIMBS лимбов, из которого берутся лимбы с FRAC_LIMBS.
+    // До 17 лимбов сумма столбца с переносом помещается в uint64_t, и деление
+    // нужно одно на столбец, а не на каждое произведение лимбов
+    constexpr FixedBCD& operator*=(const FixedBCD& other) {
+        std::array<uint32_t, 2 * LIMBS> product{};
+        if constexpr (LIMBS <= 17) {
+            // Старшие нулевые лимбы (малая целая часть) не умножаем
+            size_t n = significant_limbs(), m = other.significant_limbs();
+            std::array<uint64_t, 2 * LIMBS> columns{};
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < m; j++) {
+                    columns[i + j] += static_cast<uint64_t>(limbs[i]) * other.limbs[j];
+                }
+            }
+            uint64_t carry = 0;
+            for (size_t k = 0; k < n + m; k++) {
+                uint64_t acc = columns[k] + carry;
+                product[k] = static_cast<uint32_t>(acc % BASE);
+                carry = acc / BASE;
+            }
+        } else {
+            for (size_t i = 0; i < LIMBS; i++) {
+                uint64_t carry = 0;
+                for (size_t j = 0; j < LIMBS; j++) {
+                    uint64_t cur = product[i + j] + static_cast<uint64_t>(limbs[i]) * other.limbs[j] + carry;
+                    product[i + j] = static_cast<uint32_t>(cur % BASE);
+                    carry = cur / BASE;
+                }
+                product[i + LIMBS] = static_cast<uint32_t>(carry);
+            }
+        }
+        for (size_t i = LIMBS + FRAC_LIMBS; i < 2 * LIMBS; i++) {
+            if (product[i] != 0) throw std::overflow_error("FixedBCD: overflow");
+        }
+        for (size_t i = 0; i < LIMBS; i++) {
+            limbs[i] = product[i + FRAC_LIMBS];
+        }
+        clear_tail();
+        check_overflow();
+        is_negative = is_negative != other.is_negative && !is_zero();
+        return *this;
+    }
+    
+    friend constexpr FixedBCD operator+(FixedBCD a, const FixedBCD& b) {
+        return a += b;
+    }
+    
+    friend constexpr FixedBCD operator-(FixedBCD a, const FixedBCD& b) {
+        return a -= b;
+    }
+    
+    friend constexpr FixedBCD operator*(FixedBCD a, const FixedBCD& b) {
+        return a *= b;
+    }
+    
+    friend constexpr bool operator==(const FixedBCD& a, const FixedBCD& b) {
+        return a.is_negative == b.is_negative && compare_magnitudes(a, b) == 0;
+    }
+    
+    friend constexpr bool operator!=(const FixedBCD& a, const FixedBCD& b) {
+        return !(a == b);
+    }
+    
+    friend constexpr bool operator<(const FixedBCD& a, const FixedBCD& b) {
+        if (a.is_negative != b.is_negative) return a.is_negative;
+        int cmp = compare_magnitudes(a, b);
+        return a.is_negative ? cmp > 0 : cmp < 0;
+    }
+    
+    friend constexpr bool operator>(const FixedBCD& a, const FixedBCD& b) {
+        return b < a;
+    }
+    
+    friend constexpr bool operator<=(const FixedBCD& a, const FixedBCD& b) {
+        return !(b < a);
+    }
+    
+    friend constexpr bool operator>=(const FixedBCD& a, const FixedBCD& b) {
+        return !(a < b);
+    }
+    
+    friend std::ostream& operator<<(std::ostream& os, const FixedBCD& value) {
+        return os << value.to_bcd();
+    }
+    
+private:
+    static constexpr uint32_t BASE = bcd_limbs::BASE;
+    static constexpr int BASE_DIGITS = bcd_limbs::BASE_DIGITS;
+    static constexpr size_t FRAC_LIMBS = (FracDigits + BASE_DIGITS - 1) / BASE_DIGITS;
+    static constexpr size_t LIMBS = FRAC_LIMBS + (IntDigits + BASE_DIGITS - 1) / BASE_DIGITS;
+    
+    std::array<uint32_t, LIMBS> limbs{};
+    bool is_negative = false;
+    
+    static constexpr uint32_t pow10(int k) {
+        uint32_t result = 1;
+        for (int i = 0; i < k; i++) result *= 10;
+        return result;
+    }
+    
+    static constexpr bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+    
+    static constexpr uint32_t parse_limb(std::string_view str, size_t begin, size_t end) {
+        uint32_t limb = 0;
+        for (size_t i = begin; i < end; i++) {
+            limb = limb * 10 + (str[i] - '0');
+        }
+        return limb;
+    }
+    
+    // Обнуляем цифры младшего лимба, выходящие за FracDigits
+    constexpr void clear_tail() {
+        if (FracDigits % BASE_DIGITS != 0) {
+            uint32_t unit = pow10(BASE_DIGITS - FracDigits % BASE_DIGITS);
+            limbs[0] -= limbs[0] % unit;
+        }
+    }
+    
+    // Целая часть не длиннее IntDigits цифр
+    constexpr void check_overflow() const {
+        if (IntDigits % BASE_DIGITS != 0 && limbs[LIMBS - 1] >= pow10(IntDigits % BASE_DIGITS)) {
+            throw std::overflow_error("FixedBCD: overflow");
+        }
+    }
+    
+    constexpr size_t significant_limbs() const {
+        size_t n = LIMBS;
+        while (n > 0 && limbs[n - 1] == 0) n--;
+        return n;
+    }
+    
+    static constexpr int compare_magnitudes(const FixedBCD& a, const FixedBCD& b) {
+        for (size_t i = LIMBS; i-- > 0;) {
+            if (a.limbs[i] != b.limbs[i]) return a.limbs[i] < b.limbs[i] ? -1 : 1;
+        }
+        return 0;
+    }
+    
+    // *this += other, где у other знак other_negative
+    constexpr void add_signed(const FixedBCD& other, bool other_negative) {
+        if (is_negative == other_negative) {
+            uint32_t carry = 0;
+            for (size_t i = 0; i < LIMBS; i++) {
+                uint32_t sum = limbs[i] + other.limbs[i] + carry;
+                carry = sum >= BASE;
+                limbs[i] = carry ? sum - BASE : sum;
+            }
+            if (carry) throw std::overflow_error("FixedBCD: overflow");
+            check_overflow();
+            return;
+        }
+        // Разные знаки: из большего модуля вычитается меньший, знак - большего
+        int cmp = compare_magnitudes(*this, other);
+        const FixedBCD& larger = cmp >= 0 ? *this : other;
+        const FixedBCD& smaller = cmp >= 0 ? other : *this;
+        bool result_negative = cmp >= 0 ? is_negative : other_negative;
+        uint32_t borrow = 0;
+        std::array<uint32_t, LIMBS> difference{};
+        for (size_t i = 0; i < LIMBS; i++) {
+            uint32_t sub = smaller.limbs[i] + borrow;
+            borrow = larger.limbs[i] < sub;
+            difference[i] = borrow ? larger.limbs[i] + BASE - sub : larger.limbs[i] - sub;
+        }
+        limbs = difference;
+        is_negative = result_negative && !is_zero();
+    }
+};
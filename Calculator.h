@@ -0,0 +1,1232 @@
+#pragma once
+#include <iostream>
+#include <deque>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <stdexcept>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <map>
+#include <tuple>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+#include "BCD.h"
+
+// Коды операций байткода. Push кладёт константу, Load - значение переменной,
+// Fail и OutOfRange - отложенные ошибки разбора: они срабатывают на своём месте
+// в программе, поэтому ошибка, встретившаяся в строке раньше, сообщается раньше,
+// как при разборе по токенам. Save копирует вершину стека в регистр, Recall
+// кладёт регистр на стек: так оптимизатор переиспользует общие подвыражения
+enum class OpCode : uint8_t {
+    Push, Plus, Minus, Mult, Div, Sin, Cos, Tg, Ctg, Exp, Log, Sqrt, Atan2, Pow, Median, Fail, OutOfRange, Load,
+    Save, Recall
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t arg;  // Push - номер константы, Load - переменной, Fail - сообщения, Save и Recall - регистра
+};
+
+// Результат разбора числового токена
+enum class NumberStatus { Ok, Invalid, OutOfRange };
+
+// Арифметика калькулятора над типом чисел T: разбор констант и операции.
+// Бинарная операция пишет результат в below - второй сверху операнд, top -
+// вершина стека, которую потом снимают. Ошибки области определения
+// бросаются с сообщениями калькулятора. Для double и float это inline-функции
+// без состояния, и шаблонный калькулятор компилируется в тот же код, что и
+// написанный для double
+template <typename T>
+class Arithmetic;
+
+template <typename F>
+class FloatingArithmetic {
+public:
+    void plus(F& below, F top) const {
+        below = top + below;
+    }
+    
+    void minus(F& below, F top) const {
+        below = below - top;
+    }
+    
+    void mult(F& below, F top) const {
+        below = top * below;
+    }
+    
+    void div(F& below, F top) const {
+        if (top == 0) {
+            throw std::runtime_error("Error: zero division");
+        }
+        below = below / top;
+    }
+    
+    void sin(F& x) const {
+        x = std::sin(x);
+    }
+    
+    void cos(F& x) const {
+        x = std::cos(x);
+    }
+    
+    void tg(F& x) const {
+        x = std::tan(x);
+    }
+    
+    void ctg(F& x) const {
+        F tan_val = std::tan(x);
+        if (tan_val == 0) {
+            throw std::runtime_error("Error: ctg argument out of domain");
+        }
+        x = 1 / tan_val;
+    }
+    
+    void exp(F& x) const {
+        x = std::exp(x);
+    }
+    
+    void log(F& x) const {
+        if (x <= 0) {
+            throw std::runtime_error("Argument <= 0 for log");
+        }
+        x = std::log(x);
+    }
+    
+    void sqrt(F& x) const {
+        if (x < 0) {
+            throw std::runtime_error("Argument < 0 for sqrt");
+        }
+        x = std::sqrt(x);
+    }
+    
+    void atan2(F& below, F top) const {
+        below = std::atan2(top, below);
+    }
+    
+    void pow(F& below, F top) const {
+        below = std::pow(below, top);
+    }
+};
+
+template <>
+class Arithmetic<double> : public FloatingArithmetic<double> {
+public:
+    // Число в смысле std::stod: самый длинный префикс, который разбирает strtod.
+    // Обычно хватает from_chars; strtod нужен для того, что from_chars не принимает
+    // или разбирает иначе (ведущий '+', пробельные символы, 0x...), и для
+    // субнормальных чисел, на которых stod сообщает о выходе за диапазон
+    static NumberStatus parse(std::string_view token, double& value) {
+        const char* last = token.data() + token.size();
+        std::from_chars_result parsed = std::from_chars(token.data(), last, value);
+        if (parsed.ec == std::errc() && parsed.ptr == last && std::fpclassify(value) != FP_SUBNORMAL) {
+            return NumberStatus::Ok;
+        }
+        std::string copy(token);
+        char* end = nullptr;
+        errno = 0;
+        value = std::strtod(copy.c_str(), &end);
+        if (end == copy.c_str()) return NumberStatus::Invalid;
+        if (errno == ERANGE) return NumberStatus::OutOfRange;
+        return NumberStatus::Ok;
+    }
+};
+
+// float - вдвое больше чисел в векторном регистре. Токен разбирается как
+// для double и округляется; конечное число вне диапазона float - OutOfRange
+template <>
+class Arithmetic<float> : public FloatingArithmetic<float> {
+public:
+    static NumberStatus parse(std::string_view token, float& value) {
+        double wide;
+        NumberStatus status = Arithmetic<double>::parse(token, wide);
+        value = static_cast<float>(wide);
+        if (status == NumberStatus::Ok && std::isfinite(wide) && std::isinf(value)) {
+            return NumberStatus::OutOfRange;
+        }
+        return status;
+    }
+};
+
+// Точная десятичная арифметика: все числа на стеке имеют ровно precision
+// знаков после точки, и каждая операция даёт точный результат, усечённый
+// до них. BCD сам теряет знаки при + и *, поэтому операнды перед операцией
+// дополняются нулями ровно на столько знаков, сколько операция отбросит.
+// Корень и элементарные функции BCD считает сам с той же точностью.
+// Числовой токен должен быть числом BCD целиком: [-]цифры[(.|,)цифры]
+template <>
+class Arithmetic<BCD> {
+public:
+    explicit Arithmetic(int precision = 20) : digits(std::max(precision, 0)) {}
+    
+    int precision() const {
+        return digits;
+    }
+    
+    NumberStatus parse(std::string_view token, BCD& value) const {
+        const char* last = token.data() + token.size();
+        std::from_chars_result parsed = from_chars(token.data(), last, value);
+        if (parsed.ec != std::errc() || parsed.ptr != last) {
+            return NumberStatus::Invalid;
+        }
+        value.set_precision(digits);
+        return NumberStatus::Ok;
+    }
+    
+    // Сумма двух чисел с digits + 1 знаками получает digits знаков
+    void plus(BCD& below, BCD& top) const {
+        widen(below, top, 1);
+        below += top;
+        below.set_precision(digits);
+    }
+    
+    void minus(BCD& below, BCD& top) const {
+        widen(below, top, 1);
+        below -= top;
+        below.set_precision(digits);
+    }
+    
+    // Произведение теряет 1 + число цифр большей целой части
+    void mult(BCD& below, BCD& top) const {
+        widen(below, top, 1 + std::max(below.integer_digits(), top.integer_digits()));
+        below *= top;
+        below.set_precision(digits);
+    }
+    
+    void div(BCD& below, BCD& top) const {
+        if (top.is_zero()) {
+            throw std::runtime_error("Error: zero division");
+        }
+        below = below.divide(top, digits);
+    }
+    
+    void sqrt(BCD& x) const {
+        if (x.is_negative && !x.is_zero()) {
+            throw std::runtime_error("Argument < 0 for sqrt");
+        }
+        x = BCD::sqrt(x, digits);
+    }
+    
+    void sin(BCD& x) const {
+        x = BCD::sin(x, digits);
+    }
+    
+    void cos(BCD& x) const {
+        x = BCD::cos(x, digits);
+    }
+    
+    void tg(BCD& x) const {
+        x = BCD::tan(x, digits);
+    }
+    
+    // У конечной десятичной дроби, кроме нуля, синус не равен нулю
+    void ctg(BCD& x) const {
+        if (x.is_zero()) {
+            throw std::runtime_error("Error: ctg argument out of domain");
+        }
+        x = BCD::cot(x, digits);
+    }
+    
+    void exp(BCD& x) const {
+        x = BCD::exp(x, digits);
+    }
+    
+    void log(BCD& x) const {
+        if (x.is_negative || x.is_zero()) {
+            throw std::runtime_error("Argument <= 0 for log");
+        }
+        x = BCD::log(x, digits);
+    }
+    
+    void atan2(BCD& below, BCD& top) const {
+        below = BCD::atan2(top, below, digits);
+    }
+    
+    // Вместо бесконечности и NaN std::pow - ошибки калькулятора
+    void pow(BCD& below, BCD& top) const {
+        if (below.is_zero() && top.is_negative && !top.is_zero()) {
+            throw std::runtime_error("Error: zero division");
+        }
+        if (below.is_negative && !below.is_zero() && top != top.floor()) {
+            throw std::runtime_error("Error: pow argument out of domain");
+        }
+        below = BCD::pow(below, top, digits);
+    }
+    
+private:
+    int digits;
+    
+    void widen(BCD& below, BCD& top, int extra) const {
+        below.set_precision(digits + extra);
+        top.set_precision(digits + extra);
+    }
+};
+
+// Скомпилированная строка RPN: токенизация, разбор чисел и поиск операций
+// выполняются один раз, а вычисление идёт по массиву инструкций
+template <typename T>
+class BasicProgram {
+public:
+    // Токены из variables - переменные, их значения передаются при вычислении.
+    // Числа разбирает arithmetic
+    static BasicProgram compile(std::string_view line, const std::vector<std::string>& variables = {},
+                                const Arithmetic<T>& arithmetic = Arithmetic<T>()) {
+        BasicProgram program;
+        program.assign(line, variables, arithmetic);
+        return program;
+    }
+    
+    // Перекомпилирует программу из новой строки, переиспользуя её буферы
+    void assign(std::string_view line, const std::vector<std::string>& variables = {},
+                const Arithmetic<T>& arithmetic = Arithmetic<T>()) {
+        names = &variables;
+        numbers = &arithmetic;
+        instructions.clear();
+        constants.clear();
+        errors.clear();
+        max_depth = 0;
+        register_count = 0;
+        is_optimized = false;
+        size_t i = 0;
+        while (i < line.size()) {
+            while (i < line.size() && line[i] == ' ') {
+                ++i;
+            }
+            if (i >= line.size()) break;
+            
+            size_t begin = i;
+            while (i < line.size() && line[i] != ' ') {
+                ++i;
+            }
+            add_token(line.substr(begin, i - begin));
+        }
+        compute_stack_size();
+        variable_count = variables.size();
+        names = nullptr;
+        numbers = nullptr;
+    }
+    
+    const std::vector<Instruction>& code() const {
+        return instructions;
+    }
+    
+    const T& constant(uint32_t index) const {
+        return constants[index];
+    }
+    
+    const std::string& error(uint32_t index) const {
+        return errors[index];
+    }
+    
+    // Наибольшая глубина стека при вычислении
+    size_t stack_size() const {
+        return max_depth;
+    }
+    
+    size_t variables() const {
+        return variable_count;
+    }
+    
+    // Число регистров под общие подвыражения
+    size_t registers() const {
+        return register_count;
+    }
+    
+    // Прошла ли программа optimize: тогда её структура проверена заранее
+    bool optimized() const {
+        return is_optimized;
+    }
+    
+    // Анализ и оптимизация для многократного вычисления. Сначала бросает
+    // структурную ошибку, как check_structure, - до любого вычисления.
+    // Затем строит по программе граф выражения: одинаковые подвыражения
+    // сливаются и считаются один раз (Save/Recall), поддеревья из констант
+    // сворачиваются в константу. Поддерево, на котором вычисление бросает
+    // исключение, не сворачивается, чтобы ошибка возникла на своём месте.
+    // Результат и ошибки вычисления те же, что у исходной программы
+    void optimize();
+    
+    // Сколько операндов снимает операция
+    static size_t operands(OpCode op) {
+        static const uint8_t table[] = {0, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 2, 2, 3, 0, 0, 0, 1, 0};
+        return table[static_cast<size_t>(op)];
+    }
+    
+    // Сообщение о нехватке операндов, как у операций Calculator
+    static const char* operand_error(OpCode op) {
+        switch (op) {
+        case OpCode::Plus: return "Incorrect input, not enough operands for plus";
+        case OpCode::Minus: return "Incorrect input, not enough operands for minus";
+        case OpCode::Mult: return "Incorrect input, not enough operands for multiplication";
+        case OpCode::Div: return "Incorrect input, not enough operands for division";
+        case OpCode::Sin: return "Incorrect input, not enough operands for sin";
+        case OpCode::Cos: return "Incorrect input, not enough operands for cos";
+        case OpCode::Tg: return "Incorrect input, not enough operands for tg";
+        case OpCode::Ctg: return "Incorrect input, not enough operands for ctg";
+        case OpCode::Exp: return "Incorrect input, not enough operands for exp";
+        case OpCode::Log: return "Incorrect input, not enough operands for log";
+        case OpCode::Sqrt: return "Incorrect input, not enough operands for sqrt";
+        case OpCode::Atan2: return "Incorrect input, not enough arguments for atan2";
+        case OpCode::Pow: return "Incorrect input, not enough arguments for pow";
+        case OpCode::Median: return "Incorrect input, not enough arguments for median";
+        default: return "";
+        }
+    }
+    
+    // Ошибки, не зависящие от значений: неизвестный токен, выход числа за диапазон,
+    // нехватка операндов, неверная глубина стека в конце. Бросает первую из них
+    // в порядке программы с тем же сообщением, что и вычисление
+    void check_structure() const {
+        size_t depth = 0;
+        for (const Instruction& instruction : instructions) {
+            if (instruction.op == OpCode::Fail) {
+                throw std::runtime_error(errors[instruction.arg]);
+            }
+            if (instruction.op == OpCode::OutOfRange) {
+                throw std::out_of_range("stod");
+            }
+            size_t pops = operands(instruction.op);
+            if (depth < pops) {
+                throw std::runtime_error(operand_error(instruction.op));
+            }
+            depth = depth - pops + 1;
+        }
+        if (depth == 0) {
+            throw std::runtime_error("Incorrect input, stack is empty");
+        }
+        if (depth > 1) {
+            throw std::runtime_error("Incorrect input, some data left");
+        }
+    }
+    
+private:
+    std::vector<Instruction> instructions;
+    std::vector<T> constants;
+    std::vector<std::string> errors;
+    size_t max_depth = 0;
+    size_t variable_count = 0;
+    size_t register_count = 0;
+    bool is_optimized = false;
+    const std::vector<std::string>* names = nullptr;  // только во время assign
+    const Arithmetic<T>* numbers = nullptr;
+    
+    static bool lookup(std::string_view token, OpCode& op) {
+        static const std::pair<std::string_view, OpCode> table[] = {
+            {"+", OpCode::Plus}, {"-", OpCode::Minus}, {"*", OpCode::Mult}, {"/", OpCode::Div},
+            {"sin", OpCode::Sin}, {"cos", OpCode::Cos}, {"tg", OpCode::Tg}, {"ctg", OpCode::Ctg},
+            {"exp", OpCode::Exp}, {"log", OpCode::Log}, {"sqrt", OpCode::Sqrt}, {"atan2", OpCode::Atan2},
+            {"pow", OpCode::Pow}, {"median", OpCode::Median}
+        };
+        for (const auto& entry : table) {
+            if (entry.first == token) {
+                op = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void add_token(std::string_view token) {
+        OpCode op;
+        if (lookup(token, op)) {
+            instructions.push_back({op, 0});
+            return;
+        }
+        for (size_t v = 0; v < names->size(); v++) {
+            if ((*names)[v] == token) {
+                instructions.push_back({OpCode::Load, static_cast<uint32_t>(v)});
+                return;
+            }
+        }
+        T value;
+        switch (numbers->parse(token, value)) {
+        case NumberStatus::Ok:
+            instructions.push_back({OpCode::Push, static_cast<uint32_t>(constants.size())});
+            constants.push_back(std::move(value));
+            break;
+        case NumberStatus::OutOfRange:
+            instructions.push_back({OpCode::OutOfRange, 0});
+            break;
+        case NumberStatus::Invalid:
+            instructions.push_back({OpCode::Fail, static_cast<uint32_t>(errors.size())});
+            errors.push_back("Incorrect input: unknown token '" + std::string(token) + "'");
+            break;
+        }
+    }
+    
+    // Глубина растёт до первой операции, которой не хватает операндов
+    // или которая завершается ошибкой разбора: дальше вычисление не идёт
+    void compute_stack_size() {
+        size_t depth = 0;
+        for (const Instruction& instruction : instructions) {
+            size_t pops = operands(instruction.op);
+            if (depth < pops || instruction.op == OpCode::Fail || instruction.op == OpCode::OutOfRange) break;
+            depth = depth - pops + 1;
+            max_depth = std::max(max_depth, depth);
+        }
+    }
+};
+
+using Program = BasicProgram<double>;
+
+// Непрерывный стек с местом под Inline элементов внутри самого объекта:
+// пока глубина не больше Inline, память не выделяется, дальше элементы
+// переносятся в кучу с удвоением ёмкости
+template <typename T, size_t Inline>
+class SmallStack {
+    static_assert(std::is_trivially_copyable<T>::value, "SmallStack copies elements with memcpy");
+public:
+    SmallStack() = default;
+    
+    SmallStack(const SmallStack& other) {
+        *this = other;
+    }
+    
+    SmallStack& operator=(const SmallStack& other) {
+        if (this != &other) {
+            count = 0;
+            reserve(other.count);
+            std::memcpy(items, other.items, other.count * sizeof(T));
+            count = other.count;
+        }
+        return *this;
+    }
+    
+    void push_back(const T& value) {
+        if (count == capacity) {
+            reserve(2 * capacity);
+        }
+        items[count++] = value;
+    }
+    
+    void pop_back() {
+        --count;
+    }
+    
+    T& back() {
+        return items[count - 1];
+    }
+    
+    const T& back() const {
+        return items[count - 1];
+    }
+    
+    T& operator[](size_t index) {
+        return items[index];
+    }
+    
+    const T& operator[](size_t index) const {
+        return items[index];
+    }
+    
+    T* data() {
+        return items;
+    }
+    
+    size_t size() const {
+        return count;
+    }
+    
+    bool empty() const {
+        return count == 0;
+    }
+    
+    void clear() {
+        count = 0;
+    }
+    
+    // Новые элементы не инициализируются
+    void resize(size_t size) {
+        reserve(size);
+        count = size;
+    }
+    
+    void reserve(size_t size) {
+        if (size <= capacity) return;
+        std::unique_ptr<T[]> grown(new T[size]);
+        std::memcpy(grown.get(), items, count * sizeof(T));
+        heap = std::move(grown);
+        items = heap.get();
+        capacity = size;
+    }
+    
+private:
+    T local[Inline];
+    std::unique_ptr<T[]> heap;
+    T* items = local;
+    size_t count = 0;
+    size_t capacity = Inline;
+};
+
+// Стек операндов по умолчанию: SmallStack для чисел, которые копируются
+// memcpy, std::vector для остальных (BCD)
+template <typename T>
+using OperandStack = typename std::conditional<std::is_trivially_copyable<T>::value, SmallStack<T, 32>, std::vector<T>>::type;
+
+// Калькулятор над типом чисел T; операции берутся из Arithmetic<T>, и выбор
+// делается при компиляции. Stack - хранилище операндов пооперационного
+// интерфейса: SmallStack или любой контейнер с push_back, pop_back, back,
+// operator[] и size, например std::deque<double>. Операции переписывают
+// вершину на месте, а не снимают операнды и кладут результат; при ошибке
+// операнды операции сняты. Массив-стек evaluate - всегда OperandStack<T>
+template <typename T = double, typename Stack = OperandStack<T>>
+class BasicCalculator {
+    Stack d;
+    OperandStack<T> frame;
+    Arithmetic<T> math;
+public:
+    explicit BasicCalculator(const Arithmetic<T>& arithmetic = Arithmetic<T>()) : math(arithmetic) {}
+    
+    const Arithmetic<T>& arithmetic() const {
+        return math;
+    }
+    
+    void push(T a) {
+        d.push_back(std::move(a));
+    }
+    
+    T pop() {
+        if (d.empty()) {
+            throw std::runtime_error("Stack is empty");
+        }
+        T a = std::move(d.back());
+        d.pop_back();
+        return a;
+    }
+    
+    size_t size() const {
+        return d.size();
+    }
+    
+    void plus() {
+        binary(&Arithmetic<T>::plus, "Incorrect input, not enough operands for plus");
+    }
+    
+    void minus() {
+        binary(&Arithmetic<T>::minus, "Incorrect input, not enough operands for minus");
+    }
+    
+    void mult() {
+        binary(&Arithmetic<T>::mult, "Incorrect input, not enough operands for multiplication");
+    }
+    
+    void div() {
+        binary(&Arithmetic<T>::div, "Incorrect input, not enough operands for division");
+    }
+    
+    void sin() {
+        unary(&Arithmetic<T>::sin, "Incorrect input, not enough operands for sin");
+    }
+    
+    void cos() {
+        unary(&Arithmetic<T>::cos, "Incorrect input, not enough operands for cos");
+    }
+    
+    void tg() {
+        unary(&Arithmetic<T>::tg, "Incorrect input, not enough operands for tg");
+    }
+    
+    void ctg() {
+        unary(&Arithmetic<T>::ctg, "Incorrect input, not enough operands for ctg");
+    }
+    
+    void exp() {
+        unary(&Arithmetic<T>::exp, "Incorrect input, not enough operands for exp");
+    }
+    void log() {
+        unary(&Arithmetic<T>::log, "Incorrect input, not enough operands for log");
+    }
+    
+    void print() {
+        if (d.size() == 0) {
+            throw std::runtime_error("Incorrect input, stack is empty");
+        } 
+        else if (d.size() > 1) {
+            throw std::runtime_error("Incorrect input, some data left");
+        }
+        else {
+            std::cout << pop();
+        }
+    }
+    
+    void sqrt() {
+        unary(&Arithmetic<T>::sqrt, "Incorrect input, not enough operands for sqrt");
+    }
+    
+    void atan2() {
+        binary(&Arithmetic<T>::atan2, "Incorrect input, not enough arguments for atan2");
+    }
+    
+    void pow() {
+        binary(&Arithmetic<T>::pow, "Incorrect input, not enough arguments for pow");
+    }
+    
+    void median() {
+        if (d.size() < 3) {
+            throw std::runtime_error("Incorrect input, not enough arguments for median");
+        }
+        T a = std::move(d.back());
+        d.pop_back();
+        T b = std::move(d.back());
+        d.pop_back();
+        median_into(d.back(), a, b);
+    }
+    
+    // Выполняет программу на собственном массиве-стеке: он выделяется под
+    // наибольшую глубину программы (и её регистры) и переиспользуется между
+    // вызовами. Ошибки и их порядок те же, что при вызове операций по токенам.
+    // У оптимизированной программы глубина проверена заранее, и вычисление
+    // идёт без проверок числа операндов. variables - значения переменных
+    T evaluate(const BasicProgram<T>& program, const T* variables = nullptr) {
+        size_t frame_size = program.stack_size() + program.registers();
+        if (frame.size() < frame_size) {
+            frame.resize(frame_size);
+        }
+        return program.optimized() ? run<false>(program, variables) : run<true>(program, variables);
+    }
+    
+private:
+    template <typename Op>
+    void unary(Op op, const char* underflow) {
+        if (d.size() < 1) {
+            throw std::runtime_error(underflow);
+        }
+        try {
+            (math.*op)(d.back());
+        } catch (...) {
+            d.pop_back();
+            throw;
+        }
+    }
+    
+    template <typename Op>
+    void binary(Op op, const char* underflow) {
+        if (d.size() < 2) {
+            throw std::runtime_error(underflow);
+        }
+        T a = std::move(d.back());
+        d.pop_back();
+        try {
+            (math.*op)(d.back(), a);
+        } catch (...) {
+            d.pop_back();
+            throw;
+        }
+    }
+    
+    // c - третий сверху, a - вершина
+    static void median_into(T& c, T& a, T& b) {
+        if ((a > b) ^ (a > c))
+            c = std::move(a);
+        else if ((b > a) ^ (b > c))
+            c = std::move(b);
+    }
+    
+    template <bool Checked>
+    T run(const BasicProgram<T>& program, const T* variables) {
+        T* base = frame.data();
+        T* top = base;
+        T* registers = base + program.stack_size();
+        for (const Instruction& instruction : program.code()) {
+            if (Checked && static_cast<size_t>(top - base) < BasicProgram<T>::operands(instruction.op)) {
+                throw std::runtime_error(BasicProgram<T>::operand_error(instruction.op));
+            }
+            switch (instruction.op) {
+            case OpCode::Push:
+                *top++ = program.constant(instruction.arg);
+                break;
+            case OpCode::Load:
+                *top++ = variables[instruction.arg];
+                break;
+            case OpCode::Save:
+                registers[instruction.arg] = top[-1];
+                break;
+            case OpCode::Recall:
+                *top++ = registers[instruction.arg];
+                break;
+            case OpCode::Plus:
+                math.plus(top[-2], top[-1]);
+                --top;
+                break;
+            case OpCode::Minus:
+                math.minus(top[-2], top[-1]);
+                --top;
+                break;
+            case OpCode::Mult:
+                math.mult(top[-2], top[-1]);
+                --top;
+                break;
+            case OpCode::Div:
+                math.div(top[-2], top[-1]);
+                --top;
+                break;
+            case OpCode::Sin:
+                math.sin(top[-1]);
+                break;
+            case OpCode::Cos:
+                math.cos(top[-1]);
+                break;
+            case OpCode::Tg:
+                math.tg(top[-1]);
+                break;
+            case OpCode::Ctg:
+                math.ctg(top[-1]);
+                break;
+            case OpCode::Exp:
+                math.exp(top[-1]);
+                break;
+            case OpCode::Log:
+                math.log(top[-1]);
+                break;
+            case OpCode::Sqrt:
+                math.sqrt(top[-1]);
+                break;
+            case OpCode::Atan2:
+                math.atan2(top[-2], top[-1]);
+                --top;
+                break;
+            case OpCode::Pow:
+                math.pow(top[-2], top[-1]);
+                --top;
+                break;
+            case OpCode::Median:
+                median_into(top[-3], top[-1], top[-2]);
+                top -= 2;
+                break;
+            case OpCode::Fail:
+                throw std::runtime_error(program.error(instruction.arg));
+            case OpCode::OutOfRange:
+                throw std::out_of_range("stod");
+            }
+        }
+        if (Checked && top == base) {
+            throw std::runtime_error("Incorrect input, stack is empty");
+        }
+        if (Checked && top - base > 1) {
+            throw std::runtime_error("Incorrect input, some data left");
+        }
+        return base[0];
+    }
+};
+
+using Calculator = BasicCalculator<>;
+
+template <typename T>
+inline void BasicProgram<T>::optimize() {
+    static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(uint64_t), "optimize keys constants by their bits");
+    check_structure();
+    if (is_optimized) return;
+    
+    // Узел графа выражения. Одинаковые узлы хранятся один раз: ключ - операция,
+    // значение константы или номер переменной и номера узлов-операндов
+    struct Node {
+        OpCode op;
+        uint32_t arg;  // Load - номер переменной
+        uint32_t operand[3];
+        T value;  // Push - значение
+    };
+    const uint32_t NONE = UINT32_MAX;
+    std::vector<Node> nodes;
+    std::map<std::tuple<OpCode, uint64_t, uint32_t, uint32_t, uint32_t>, uint32_t> known;
+    auto intern = [&](const Node& node) {
+        uint64_t arg = node.arg;
+        if (node.op == OpCode::Push) {
+            std::memcpy(&arg, &node.value, sizeof(node.value));
+        }
+        auto key = std::make_tuple(node.op, arg, node.operand[0], node.operand[1], node.operand[2]);
+        auto found = known.find(key);
+        if (found != known.end()) {
+            return found->second;
+        }
+        nodes.push_back(node);
+        known.emplace(key, static_cast<uint32_t>(nodes.size() - 1));
+        return static_cast<uint32_t>(nodes.size() - 1);
+    };
+    
+    // Свёртка считает операцию тем же Calculator::evaluate на программе
+    // из констант-операндов, поэтому результат совпадает бит в бит
+    BasicCalculator<T> calc;
+    BasicProgram fold;
+    std::vector<uint32_t> stack;
+    for (const Instruction& instruction : instructions) {
+        Node node{instruction.op, 0, {NONE, NONE, NONE}, T()};
+        if (instruction.op == OpCode::Push) {
+            node.value = constants[instruction.arg];
+        } else if (instruction.op == OpCode::Load) {
+            node.arg = instruction.arg;
+        } else {
+            size_t pops = operands(instruction.op);
+            bool constant = true;
+            for (size_t i = 0; i < pops; i++) {
+                node.operand[i] = stack[stack.size() - pops + i];
+                constant = constant && nodes[node.operand[i]].op == OpCode::Push;
+            }
+            stack.resize(stack.size() - pops);
+            if (constant) {
+                fold.instructions.clear();
+                fold.constants.clear();
+                for (size_t i = 0; i < pops; i++) {
+                    fold.instructions.push_back({OpCode::Push, static_cast<uint32_t>(i)});
+                    fold.constants.push_back(nodes[node.operand[i]].value);
+                }
+                fold.instructions.push_back({instruction.op, 0});
+                fold.max_depth = pops;
+                try {
+                    node = Node{OpCode::Push, 0, {NONE, NONE, NONE}, calc.evaluate(fold)};
+                } catch (const std::exception&) {
+                    // Ошибка останется на своём месте в программе
+                }
+            }
+        }
+        stack.push_back(intern(node));
+    }
+    uint32_t root = stack.back();
+    
+    // Сколько раз на узел ссылаются достижимые из корня узлы
+    std::vector<uint32_t> uses(nodes.size(), 0);
+    std::vector<bool> reached(nodes.size(), false);
+    std::vector<uint32_t> pending{root};
+    reached[root] = true;
+    while (!pending.empty()) {
+        const Node& node = nodes[pending.back()];
+        pending.pop_back();
+        for (size_t i = 0; i < operands(node.op); i++) {
+            uint32_t operand = node.operand[i];
+            uses[operand]++;
+            if (!reached[operand]) {
+                reached[operand] = true;
+                pending.push_back(operand);
+            }
+        }
+    }
+    
+    // Обход в том же порядке, что у исходной программы: операнды слева направо.
+    // Общая операция при первом вычислении сохраняется в регистр, дальше
+    // берётся из него; константы и переменные просто кладутся заново
+    std::vector<Instruction> code;
+    std::vector<T> values;
+    std::vector<uint32_t> constant_index(nodes.size(), NONE);
+    std::vector<uint32_t> saved(nodes.size(), NONE);
+    register_count = 0;
+    struct Frame {
+        uint32_t node;
+        size_t next;
+    };
+    std::vector<Frame> path{{root, 0}};
+    while (!path.empty()) {
+        uint32_t id = path.back().node;
+        const Node& node = nodes[id];
+        size_t pops = operands(node.op);
+        if (path.back().next < pops) {
+            uint32_t operand = node.operand[path.back().next++];
+            if (saved[operand] != NONE) {
+                code.push_back({OpCode::Recall, saved[operand]});
+            } else {
+                path.push_back({operand, 0});
+            }
+            continue;
+        }
+        path.pop_back();
+        if (node.op == OpCode::Push) {
+            if (constant_index[id] == NONE) {
+                constant_index[id] = static_cast<uint32_t>(values.size());
+                values.push_back(node.value);
+            }
+            code.push_back({OpCode::Push, constant_index[id]});
+        } else {
+            code.push_back({node.op, node.arg});
+        }
+        if (pops > 0 && uses[id] > 1) {
+            saved[id] = static_cast<uint32_t>(register_count++);
+            code.push_back({OpCode::Save, saved[id]});
+        }
+    }
+    
+    instructions = std::move(code);
+    constants = std::move(values);
+    errors.clear();
+    max_depth = 0;
+    compute_stack_size();
+    is_optimized = true;
+}
+
+// Ошибки строк столбцового режима: ошибки области определения не прерывают
+// пакет, а отмечаются у своей строки. У строки запоминается первая ошибка
+enum class RowError : uint8_t { None, ZeroDivision, CtgDomain, LogDomain, SqrtDomain };
+
+inline const char* rowErrorMessage(RowError error) {
+    switch (error) {
+    case RowError::ZeroDivision: return "Error: zero division";
+    case RowError::CtgDomain: return "Error: ctg argument out of domain";
+    case RowError::LogDomain: return "Argument <= 0 for log";
+    case RowError::SqrtDomain: return "Argument < 0 for sqrt";
+    default: return "";
+    }
+}
+
+inline void markRow(RowError* status, size_t i, RowError error) {
+    if (status[i] == RowError::None) status[i] = error;
+}
+
+// Ядра над блоком из n строк. В бинарных a - второй сверху операнд, b - верхний,
+// как b и a в операциях Calculator; out может совпадать с a или b.
+// Арифметика, sqrt и median дают те же биты, что и скалярные операции
+struct ColumnKernels {
+    void (*plus)(const double* a, const double* b, double* out, size_t n);
+    void (*minus)(const double* a, const double* b, double* out, size_t n);
+    void (*mult)(const double* a, const double* b, double* out, size_t n);
+    void (*div)(const double* a, const double* b, double* out, RowError* status, size_t n);
+    void (*sqrt)(const double* a, double* out, RowError* status, size_t n);
+    void (*median)(const double* a, const double* b, const double* c, double* out, size_t n);
+    const char* name;
+};
+
+inline void plus_scalar(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = b[i] + a[i];
+}
+
+inline void minus_scalar(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] - b[i];
+}
+
+inline void mult_scalar(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = b[i] * a[i];
+}
+
+inline void div_scalar(const double* a, const double* b, double* out, RowError* status, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (b[i] == 0) markRow(status, i, RowError::ZeroDivision);
+        out[i] = a[i] / b[i];
+    }
+}
+
+inline void sqrt_scalar(const double* a, double* out, RowError* status, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] < 0) markRow(status, i, RowError::SqrtDomain);
+        out[i] = std::sqrt(a[i]);
+    }
+}
+
+// c - верхний операнд, a - третий сверху, как в Calculator::median
+inline double median3(double a, double b, double c) {
+    if ((c > b) ^ (c > a))
+        return c;
+    else if ((b > c) ^ (b > a))
+        return b;
+    else
+        return a;
+}
+
+inline void median_scalar(const double* a, const double* b, const double* c, double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = median3(a[i], b[i], c[i]);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("avx2")))
+inline void plus_avx2(const double* a, const double* b, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(b + i), _mm256_loadu_pd(a + i)));
+    }
+    plus_scalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline void minus_avx2(const double* a, const double* b, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    minus_scalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline void mult_avx2(const double* a, const double* b, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(b + i), _mm256_loadu_pd(a + i)));
+    }
+    mult_scalar(a + i, b + i, out + i, n - i);
+}
+
+// Маска нулевых делителей проверяется целиком, строки отмечаются только при попадании
+__attribute__((target("avx2")))
+inline void div_avx2(const double* a, const double* b, double* out, RowError* status, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d divisor = _mm256_loadu_pd(b + i);
+        int zeros = _mm256_movemask_pd(_mm256_cmp_pd(divisor, zero, _CMP_EQ_OQ));
+        for (; zeros != 0; zeros &= zeros - 1) {
+            markRow(status, i + __builtin_ctz(zeros), RowError::ZeroDivision);
+        }
+        _mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_loadu_pd(a + i), divisor));
+    }
+    div_scalar(a + i, b + i, out + i, status + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline void sqrt_avx2(const double* a, double* out, RowError* status, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        int negative = _mm256_movemask_pd(_mm256_cmp_pd(x, zero, _CMP_LT_OQ));
+        for (; negative != 0; negative &= negative - 1) {
+            markRow(status, i + __builtin_ctz(negative), RowError::SqrtDomain);
+        }
+        _mm256_storeu_pd(out + i, _mm256_sqrt_pd(x));
+    }
+    sqrt_scalar(a + i, out + i, status + i, n - i);
+}
+
+// Выбор без ветвлений: маски сравнений как в median3, затем два blend
+__attribute__((target("avx2")))
+inline void median_avx2(const double* a, const double* b, const double* c, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256d y = _mm256_loadu_pd(b + i);
+        __m256d z = _mm256_loadu_pd(c + i);
+        __m256d take_z = _mm256_xor_pd(_mm256_cmp_pd(z, y, _CMP_GT_OQ), _mm256_cmp_pd(z, x, _CMP_GT_OQ));
+        __m256d take_y = _mm256_xor_pd(_mm256_cmp_pd(y, z, _CMP_GT_OQ), _mm256_cmp_pd(y, x, _CMP_GT_OQ));
+        __m256d result = _mm256_blendv_pd(x, y, take_y);
+        _mm256_storeu_pd(out + i, _mm256_blendv_pd(result, z, take_z));
+    }
+    median_scalar(a + i, b + i, c + i, out + i, n - i);
+}
+#endif
+
+inline ColumnKernels selectColumnKernels() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {plus_avx2, minus_avx2, mult_avx2, div_avx2, sqrt_avx2, median_avx2, "avx2"};
+    }
+#endif
+    return {plus_scalar, minus_scalar, mult_scalar, div_scalar, sqrt_scalar, median_scalar, "scalar"};
+}
+
+inline const ColumnKernels& columnKernels() {
+    static const ColumnKernels selected = selectColumnKernels();
+    return selected;
+}
+
+// Одна программа над столбцами входов: строки идут блоками по BLOCK, и каждая
+// ячейка стека - это столбец блока. Load не копирует вход, а ссылается на него.
+// Ошибки структуры программы одинаковы для всех строк и бросаются до вычисления;
+// ошибки области определения пишутся в errors[row], а out[row] тогда NaN.
+// sin, cos, tg, ctg, exp, log, pow и atan2 считаются std-функциями поэлементно,
+// чтобы результат совпадал со скалярным вычислением бит в бит
+class ColumnEvaluator {
+public:
+    static constexpr size_t BLOCK = 512;
+    
+    // inputs[v][row] - значение переменной v в строке row
+    void evaluate(const Program& program, const double* const* inputs, size_t rows, double* out, RowError* errors) {
+        program.check_structure();
+        size_t depth_limit = program.stack_size();
+        if (scratch.size() < depth_limit * BLOCK) {
+            scratch.resize(depth_limit * BLOCK);
+        }
+        views.resize(depth_limit);
+        if (registers.size() < program.registers() * BLOCK) {
+            registers.resize(program.registers() * BLOCK);
+        }
+        for (size_t row = 0; row < rows; row += BLOCK) {
+            size_t n = std::min(BLOCK, rows - row);
+            evaluate_block(program, inputs, row, n, out + row, errors + row);
+        }
+    }
+    
+private:
+    std::vector<double> scratch;       // столбец на каждую глубину стека
+    std::vector<const double*> views;  // что лежит на глубине: scratch или вход
+    std::vector<double> registers;     // столбцы регистров Save/Recall
+    
+    template <typename F>
+    static void map(const double* a, double* out, size_t n, F f) {
+        for (size_t i = 0; i < n; i++) out[i] = f(a[i]);
+    }
+    
+    template <typename F>
+    static void map(const double* a, const double* b, double* out, size_t n, F f) {
+        for (size_t i = 0; i < n; i++) out[i] = f(a[i], b[i]);
+    }
+    
+    void evaluate_block(const Program& program, const double* const* inputs, size_t row, size_t n, double* out, RowError* status) {
+        const ColumnKernels& kernels = columnKernels();
+        std::fill(status, status + n, RowError::None);
+        size_t depth = 0;
+        for (const Instruction& instruction : program.code()) {
+            // Результат кладётся в столбец scratch своей глубины
+            size_t pops = Program::operands(instruction.op);
+            size_t target = depth - pops;
+            double* result = scratch.data() + target * BLOCK;
+            const double* a = pops >= 1 ? views[depth - 1] : nullptr;
+            const double* b = pops >= 2 ? views[depth - 2] : nullptr;
+            switch (instruction.op) {
+            case OpCode::Push:
+                std::fill(result, result + n, program.constant(instruction.arg));
+                break;
+            case OpCode::Load:
+                views[depth++] = inputs[instruction.arg] + row;
+                continue;
+            case OpCode::Save:
+                // Столбец глубины может быть перезаписан, пока регистр нужен
+                std::copy(a, a + n, registers.data() + instruction.arg * BLOCK);
+                views[target] = a;
+                depth = target + 1;
+                continue;
+            case OpCode::Recall:
+                views[depth++] = registers.data() + instruction.arg * BLOCK;
+                continue;
+            case OpCode::Plus: kernels.plus(b, a, result, n); break;
+            case OpCode::Minus: kernels.minus(b, a, result, n); break;
+            case OpCode::Mult: kernels.mult(b, a, result, n); break;
+            case OpCode::Div: kernels.div(b, a, result, status, n); break;
+            case OpCode::Sqrt: kernels.sqrt(a, result, status, n); break;
+            case OpCode::Median: kernels.median(views[depth - 3], b, a, result, n); break;
+            // Векторные ядра (AVX2) есть только у + - * / sqrt median выше. Остальные
+            // столбцы - поэлементные вызовы std:: ради совпадения бит в бит со
+            // скалярным вычислением; векторные sin/exp/log дали бы другие младшие биты
+            case OpCode::Sin: map(a, result, n, [](double x) { return std::sin(x); }); break;
+            case OpCode::Cos: map(a, result, n, [](double x) { return std::cos(x); }); break;
+            case OpCode::Tg: map(a, result, n, [](double x) { return std::tan(x); }); break;
+            case OpCode::Exp: map(a, result, n, [](double x) { return std::exp(x); }); break;
+            case OpCode::Ctg:
+                for (size_t i = 0; i < n; i++) {
+                    double tan_val = std::tan(a[i]);
+                    if (tan_val == 0) markRow(status, i, RowError::CtgDomain);
+                    result[i] = 1 / tan_val;
+                }
+                break;
+            case OpCode::Log:
+                for (size_t i = 0; i < n; i++) {
+                    if (a[i] <= 0) markRow(status, i, RowError::LogDomain);
+                    result[i] = std::log(a[i]);
+                }
+                break;
+            case OpCode::Atan2: map(a, b, result, n, [](double x, double y) { return std::atan2(x, y); }); break;
+            case OpCode::Pow: map(b, a, result, n, [](double x, double y) { return std::pow(x, y); }); break;
+            case OpCode::Fail:
+            case OpCode::OutOfRange:
+                break;  // отсеяны check_structure
+            }
+            views[target] = result;
+            depth = target + 1;
+        }
+        const double* value = views[0];
+        for (size_t i = 0; i < n; i++) {
+            out[i] = status[i] == RowError::None ? value[i] : std::nan("");
+        }
+    }
+};
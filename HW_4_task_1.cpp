@@ -1,254 +1,769 @@
 #include<iostream>
-#include <deque>
-#include <cmath>
 #include <string>
 #include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <string_view>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <csignal>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "Calculator.h"
 
-class Calculator {
-    std::deque<double> d;
+// Построчное чтение большими блоками через fread: строка, не поместившаяся
+// в блок целиком, переносится в начало буфера перед следующим чтением
+class LineReader {
 public:
-    void push(double a) {
-        d.push_back(a);
-    }
+    explicit LineReader(std::FILE* file) : file(file), buffer(1 << 20) {}
     
-    double pop() {
-        if (d.empty()) {
-            throw std::runtime_error("Stack is empty");
+    bool next(std::string_view& line) {
+        for (;;) {
+            const char* start = buffer.data() + pos;
+            const char* eol = static_cast<const char*>(std::memchr(start, '\n', end - pos));
+            if (eol) {
+                line = std::string_view(start, eol - start);
+                pos = eol - buffer.data() + 1;
+                return true;
+            }
+            if (eof) {
+                // Последняя строка без перевода строки
+                if (pos == end) return false;
+                line = std::string_view(start, end - pos);
+                pos = end;
+                return true;
+            }
+            std::memmove(buffer.data(), start, end - pos);
+            end -= pos;
+            pos = 0;
+            if (end == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+            size_t got = std::fread(buffer.data() + end, 1, buffer.size() - end, file);
+            end += got;
+            eof = got == 0;
         }
-        double a = d.back();
-        d.pop_back();
-        return a;
     }
     
-    size_t size() const {
-        return d.size();
-    }
+private:
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t end = 0;
+    bool eof = false;
+};
+
+// Результат строки, как std::cout << value: double и float - %g с 6 значащими
+// цифрами, BCD - все знаки точности
+template <typename Output>
+void writeResult(Output& output, double value) {
+    char text[32];
+    std::to_chars_result printed = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+    output.write(std::string_view(text, printed.ptr - text));
+}
+
+template <typename Output>
+void writeResult(Output& output, float value) {
+    char text[32];
+    std::to_chars_result printed = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+    output.write(std::string_view(text, printed.ptr - text));
+}
+
+template <typename Output>
+void writeResult(Output& output, const BCD& value) {
+    static thread_local std::string text;
+    text.resize(value.formatted_size());
+    to_chars(&text[0], &text[0] + text.size(), value);
+    output.write(text);
+}
+
+// Буфер вывода: сбрасывается целыми блоками, без flush на каждой строке
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::FILE* file) : file(file), buffer(1 << 16) {}
     
-    void plus() {
-        if (d.size() < 2) {
-            throw std::runtime_error("Incorrect input, not enough operands for plus");
-        }
-        double a = pop();
-        double b = pop();
-        push(a + b);
+    ~OutputBuffer() {
+        flush();
     }
     
-    void minus() {
-        if (d.size() < 2) {
-            throw std::runtime_error("Incorrect input, not enough operands for minus");
+    void write(std::string_view text) {
+        if (size + text.size() > buffer.size()) {
+            flush();
+            if (text.size() > buffer.size()) {
+                std::fwrite(text.data(), 1, text.size(), file);
+                return;
+            }
         }
-        double a = pop();
-        double b = pop();
-        push(b - a);
+        std::memcpy(buffer.data() + size, text.data(), text.size());
+        size += text.size();
     }
     
-    void mult() {
-        if (d.size() < 2) {
-            throw std::runtime_error("Incorrect input, not enough operands for multiplication");
-        }
-        double a = pop();
-        double b = pop();
-        push(a * b);
+    void flush() {
+        std::fwrite(buffer.data(), 1, size, file);
+        size = 0;
     }
     
-    void div() {
-        if (d.size() < 2) {
-            throw std::runtime_error("Incorrect input, not enough operands for division");
-        }
-        double a = pop();
-        double b = pop();
-        if (a == 0) {
-            throw std::runtime_error("Error: zero division");
-        }
-        push(b / a);
+private:
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t size = 0;
+};
+
+// Вывод одного куска пакета в память: печатается позже, в порядке кусков
+class ChunkOutput {
+public:
+    void write(std::string_view text) {
+        buffer.insert(buffer.end(), text.begin(), text.end());
     }
     
-    void sin() {
-        if (d.size() < 1) {
-            throw std::runtime_error("Incorrect input, not enough operands for sin");
-        }
-        double a = pop();
-        push(std::sin(a));
+    void clear() {
+        buffer.clear();
     }
     
-    void cos() {
-        if (d.size() < 1) {
-            throw std::runtime_error("Incorrect input, not enough operands for cos");
-        }
-        double a = pop();
-        push(std::cos(a));
+    const std::vector<char>& text() const {
+        return buffer;
     }
     
-    void tg() {
-        if (d.size() < 1) {
-            throw std::runtime_error("Incorrect input, not enough operands for tg");
+private:
+    std::vector<char> buffer;
+};
+
+// Строка пакета: результат или сообщение об ошибке и перевод строки.
+// Возвращает false, если строка завершилась ошибкой
+template <typename T, typename Output>
+bool evaluateLine(std::string_view line, BasicProgram<T>& program, BasicCalculator<T>& calc, Output& output) {
+    bool ok = true;
+    try {
+        program.assign(line, {}, calc.arithmetic());
+        writeResult(output, calc.evaluate(program));
+    } catch (const std::exception& e) {
+        output.write(e.what());
+        ok = false;
+    }
+    output.write("\n");
+    return ok;
+}
+
+// Потоковый режим: по выражению в строке, на каждое - строка с результатом или
+// сообщением об ошибке, как в обычном режиме. Программа и калькулятор
+// переиспользуются между строками. Код возврата 1, если была хоть одна ошибка
+template <typename T>
+int runBatch(std::FILE* input, const Arithmetic<T>& arithmetic) {
+    LineReader reader(input);
+    OutputBuffer output(stdout);
+    BasicProgram<T> program;
+    BasicCalculator<T> calc(arithmetic);
+    bool failed = false;
+    std::string_view line;
+    while (reader.next(line)) {
+        failed |= !evaluateLine(line, program, calc, output);
+    }
+    output.flush();
+    return failed ? 1 : 0;
+}
+
+// Ожидание без блокировок: сначала активное, затем с уступкой процессора
+// и короткими паузами, если ждать приходится долго (медленный ввод)
+template <typename Predicate>
+void spinUntil(Predicate ready) {
+    for (unsigned spins = 0; !ready(); spins++) {
+        if (spins < 64) continue;
+        if (spins < 4096) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
         }
-        double a = pop();
-        push(std::tan(a));
     }
+}
+
+// Кусок входа из целых строк и его вывод. Кусок k лежит в слоте k % slots;
+// turn == 2k + 1 - вход куска k готов, turn == 2k + 2 - вывод готов.
+// Через turn передаётся и владение буферами, поэтому других блокировок нет
+struct BatchChunk {
+    std::vector<char> input;
+    size_t size = 0;
+    ChunkOutput output;
+    bool failed = false;
+    std::atomic<size_t> turn{0};
+};
+
+// Параллельный потоковый режим. Главный поток читает вход кусками по целым
+// строкам и печатает готовые куски строго по порядку; рабочие берут куски
+// по возрастанию номера, у каждого свои Program и Calculator.
+// Слотов вдвое больше рабочих: чтение и печать не ждут отстающий кусок,
+// пока не исчерпан запас. Вывод совпадает с runBatch байт в байт
+template <typename T>
+int runParallelBatch(std::FILE* input, size_t threads, const Arithmetic<T>& arithmetic) {
+    constexpr size_t CHUNK = 1 << 20;
+    const size_t slots = 2 * threads + 2;
+    std::vector<BatchChunk> chunks(slots);
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<size_t> total{SIZE_MAX};  // число кусков, известно после конца входа
     
-    void ctg() {
-        if (d.size() < 1) {
-            throw std::runtime_error("Incorrect input, not enough operands for ctg");
-        }
-        double a = pop();
-        double tan_val = std::tan(a);
-        if (tan_val == 0) {
-            throw std::runtime_error("Error: ctg argument out of domain");
+    auto work = [&]() {
+        BasicProgram<T> program;
+        BasicCalculator<T> calc(arithmetic);
+        for (;;) {
+            size_t k = next_chunk.fetch_add(1, std::memory_order_relaxed);
+            BatchChunk& chunk = chunks[k % slots];
+            bool exists = true;
+            spinUntil([&]() {
+                if (chunk.turn.load(std::memory_order_acquire) == 2 * k + 1) return true;
+                exists = k < total.load(std::memory_order_acquire);
+                return !exists;
+            });
+            if (!exists) return;
+            chunk.output.clear();
+            chunk.failed = false;
+            const char* pos = chunk.input.data();
+            const char* end = pos + chunk.size;
+            while (pos != end) {
+                const char* eol = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+                const char* stop = eol ? eol : end;
+                chunk.failed |= !evaluateLine(std::string_view(pos, stop - pos), program, calc, chunk.output);
+                pos = eol ? eol + 1 : end;
+            }
+            chunk.turn.store(2 * k + 2, std::memory_order_release);
         }
-        push(1 / tan_val);
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(work);
     }
     
-    void exp() {
-        if (d.size() < 1) {
-            throw std::runtime_error("Incorrect input, not enough operands for exp");
+    bool failed = false;
+    size_t printed = 0;
+    auto print_next = [&]() {
+        BatchChunk& chunk = chunks[printed % slots];
+        spinUntil([&]() { return chunk.turn.load(std::memory_order_acquire) == 2 * printed + 2; });
+        const std::vector<char>& text = chunk.output.text();
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        failed |= chunk.failed;
+        printed++;
+    };
+    
+    // Хвост без перевода строки переносится в следующий кусок
+    std::vector<char> carry;
+    size_t read = 0;
+    for (bool eof = false; !eof; ) {
+        if (read >= slots) {
+            print_next();  // освобождает слот куска read - slots
         }
-        double a = pop();
-        push(std::exp(a));
-    }
-    void log() {
-        if (d.size() < 1) {
-            throw std::runtime_error("Incorrect input, not enough operands for log");
+        BatchChunk& chunk = chunks[read % slots];
+        std::vector<char>& buffer = chunk.input;
+        if (buffer.size() < std::max(CHUNK, 2 * carry.size())) {
+            buffer.resize(std::max(CHUNK, 2 * carry.size()));
         }
-        double a = pop();
-        if (a <= 0) {
-            throw std::runtime_error("Argument <= 0 for log");
+        std::memcpy(buffer.data(), carry.data(), carry.size());
+        size_t filled = carry.size();
+        size_t lines_end = 0;
+        for (;;) {
+            size_t got = std::fread(buffer.data() + filled, 1, buffer.size() - filled, input);
+            filled += got;
+            eof = got == 0;
+            const char* last = nullptr;
+            for (size_t i = filled; i > 0; i--) {
+                if (buffer[i - 1] == '\n') {
+                    last = buffer.data() + i - 1;
+                    break;
+                }
+            }
+            if (eof) {
+                lines_end = filled;
+                break;
+            }
+            if (last) {
+                lines_end = last - buffer.data() + 1;
+                break;
+            }
+            // Строка длиннее куска
+            if (filled == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
         }
-        push(std::log(a));
+        carry.assign(buffer.begin() + lines_end, buffer.begin() + filled);
+        if (lines_end == 0) break;
+        chunk.size = lines_end;
+        chunk.turn.store(2 * read + 1, std::memory_order_release);
+        read++;
     }
-    
-    void print() {
-        if (d.size() == 0) {
-            throw std::runtime_error("Incorrect input, stack is empty");
-        } 
-        else if (d.size() > 1) {
-            throw std::runtime_error("Incorrect input, some data left");
-        }
-        else {
-            std::cout << pop();
-        }
+    total.store(read, std::memory_order_release);
+    while (printed < read) {
+        print_next();
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
     }
+    std::fflush(stdout);
+    return failed ? 1 : 0;
+}
+
+// Кэш скомпилированных программ по тексту выражения. При переполнении
+// вытесняется программа, которая дольше всех не запрашивалась; её узел
+// переиспользуется вместе с буферами. Ключи индекса смотрят в строки узлов
+// списка, адреса которых не меняются
+template <typename T>
+class ProgramCache {
+public:
+    ProgramCache(size_t capacity, const Arithmetic<T>& arithmetic)
+        : capacity(std::max<size_t>(capacity, 1)), arithmetic(arithmetic) {}
     
-    void sqrt() {
-        if (d.size() < 1) {
-            throw std::runtime_error("Incorrect input, not enough operands for sqrt");
+    const BasicProgram<T>& get(std::string_view line) {
+        auto found = index.find(line);
+        if (found != index.end()) {
+            entries.splice(entries.begin(), entries, found->second);
+            hit_count++;
+            return found->second->program;
         }
-        double a = pop();
-        if (a < 0) {
-            throw std::runtime_error("Argument < 0 for sqrt");
+        if (entries.size() == capacity) {
+            index.erase(entries.back().text);
+            entries.splice(entries.begin(), entries, std::prev(entries.end()));
+        } else {
+            entries.emplace_front();
         }
-        push(std::sqrt(a));
+        Entry& entry = entries.front();
+        entry.text.assign(line);
+        entry.program.assign(line, {}, arithmetic);
+        index.emplace(entry.text, entries.begin());
+        miss_count++;
+        return entry.program;
     }
     
-    void atan2() {
-        if (d.size() < 2) {
-            throw std::runtime_error("Incorrect input, not enough arguments for atan2");
-        }
-        double a = pop();
-        double b = pop();
-        push(std::atan2(a, b));
+    size_t hits() const {
+        return hit_count;
     }
     
-    void pow() {
-        if (d.size() < 2) {
-            throw std::runtime_error("Incorrect input, not enough arguments for pow");
-        }
-        double a = pop();
-        double b = pop();
-        push(std::pow(b, a));
+    size_t misses() const {
+        return miss_count;
     }
     
-    void median() {
-        if (d.size() < 3) {
-            throw std::runtime_error("Incorrect input, not enough arguments for median");
-        }
-        double a = pop();
-        double b = pop();
-        double c = pop();
-        if ((a > b) ^ (a > c)) 
-            push(a);
-        else if ((b > a) ^ (b > c)) 
-            push(b);
-        else 
-            push(c);
+private:
+    struct Entry {
+        std::string text;
+        BasicProgram<T> program;
+    };
+    
+    size_t capacity;
+    Arithmetic<T> arithmetic;
+    std::list<Entry> entries;  // от недавно запрошенных к давним
+    std::unordered_map<std::string_view, typename std::list<Entry>::iterator> index;
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+};
+
+#if defined(__linux__)
+inline volatile std::sig_atomic_t server_stop = 0;
+
+inline void requestServerStop(int) {
+    server_stop = 1;
+}
+
+// Соединение сервера: недочитанный хвост запроса, ответы, ещё не ушедшие
+// в сокет, и свой калькулятор
+template <typename T>
+struct ServerConnection {
+    explicit ServerConnection(int fd, const Arithmetic<T>& arithmetic) : fd(fd), calc(arithmetic) {}
+    
+    int fd;
+    std::string input;
+    ChunkOutput output;
+    size_t sent = 0;
+    uint32_t events = 0;
+    bool closing = false;  // клиент закрыл запись: дописать ответы и закрыть
+    BasicCalculator<T> calc;
+    
+    size_t pending() const {
+        return output.text().size() - sent;
     }
 };
 
-int main() {
-    std::string input_line;
-    std::getline(std::cin, input_line);
+// Сервер на сокете Unix: по выражению в строке, на каждое - строка ответа,
+// как в пакетном режиме, в порядке запросов. Клиент может слать запросы,
+// не дожидаясь ответов. Один поток с epoll: все готовые строки из прочитанного
+// вычисляются сразу, ответы копятся в буфере соединения и уходят, когда сокет
+// готов к записи. Пока у соединения не отправлено больше OUTPUT_LIMIT байт,
+// новые запросы из него не читаются. Останавливается по SIGINT и SIGTERM
+template <typename T>
+int runServer(const char* path, size_t cache_size, const Arithmetic<T>& arithmetic) {
+    constexpr size_t OUTPUT_LIMIT = 1 << 22;
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(address.sun_path)) {
+        std::cout << "Socket path is too long: " << path;
+        return 1;
+    }
+    std::strcpy(address.sun_path, path);
+    int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ::unlink(path);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(listener, SOMAXCONN) != 0) {
+        std::cout << "Cannot listen on " << path << ": " << std::strerror(errno);
+        return 1;
+    }
+    int poller = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event listen_event{};
+    listen_event.events = EPOLLIN;
+    listen_event.data.ptr = nullptr;
+    ::epoll_ctl(poller, EPOLL_CTL_ADD, listener, &listen_event);
+    std::signal(SIGINT, requestServerStop);
+    std::signal(SIGTERM, requestServerStop);
     
-    Calculator calc;
+    ProgramCache<T> cache(cache_size, arithmetic);
+    std::unordered_map<int, std::unique_ptr<ServerConnection<T>>> connections;
+    std::vector<char> buffer(1 << 16);
     
-    try {
-        size_t i = 0;
-        while (i < input_line.size()) {
-            while (i < input_line.size() && input_line[i] == ' ') {
-                ++i;
-            }
-            if (i >= input_line.size()) break;
-            
-            std::string token;
-            while (i < input_line.size() && input_line[i] != ' ') {
-                token += input_line[i];
-                ++i;
+    auto close_connection = [&](ServerConnection<T>& connection) {
+        ::epoll_ctl(poller, EPOLL_CTL_DEL, connection.fd, nullptr);
+        ::close(connection.fd);
+        connections.erase(connection.fd);
+    };
+    // Интерес к событиям следует за состоянием буферов
+    auto update_events = [&](ServerConnection<T>& connection) {
+        uint32_t events = 0;
+        if (!connection.closing && connection.pending() < OUTPUT_LIMIT) events |= EPOLLIN;
+        if (connection.pending() > 0) events |= EPOLLOUT;
+        if (events != connection.events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.ptr = &connection;
+            ::epoll_ctl(poller, EPOLL_CTL_MOD, connection.fd, &event);
+            connection.events = events;
+        }
+    };
+    // Возвращает false, если соединение пора закрыть
+    auto flush = [&](ServerConnection<T>& connection) {
+        while (connection.pending() > 0) {
+            ssize_t written = ::send(connection.fd, connection.output.text().data() + connection.sent,
+                                     connection.pending(), MSG_NOSIGNAL);
+            if (written < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
             }
-            
-            if (token.empty()) continue;
+            connection.sent += written;
+        }
+        connection.output.clear();
+        connection.sent = 0;
+        return !connection.closing;
+    };
+    auto serve = [&](ServerConnection<T>& connection) {
+        size_t start = 0;
+        for (;;) {
+            size_t eol = connection.input.find('\n', start);
+            if (eol == std::string::npos) break;
+            std::string_view line(connection.input.data() + start, eol - start);
             try {
-                double number = std::stod(token);
-                calc.push(number);
-            } catch (const std::invalid_argument&) {
-                if (token == "+") {
-                    calc.plus();
-                }
-                else if (token == "-") {
-                    calc.minus();
-                }
-                else if (token == "*") {
-                    calc.mult();
-                }
-                else if (token == "/") {
-                    calc.div();
-                }
-                else if (token == "sin") {
-                    calc.sin();
-                }
-                else if (token == "cos") {
-                    calc.cos();
-                }
-                else if (token == "tg") {
-                    calc.tg();
-                }
-                else if (token == "ctg") {
-                    calc.ctg();
-                }
-                else if (token == "exp") {
-                    calc.exp();
-                }
-                else if (token == "log") {
-                    calc.log();
-                }
-                else if (token == "sqrt") {
-                    calc.sqrt();
-                }
-                else if (token == "atan2") {
-                    calc.atan2();
+                writeResult(connection.output, connection.calc.evaluate(cache.get(line)));
+            } catch (const std::exception& e) {
+                connection.output.write(e.what());
+            }
+            connection.output.write("\n");
+            start = eol + 1;
+        }
+        connection.input.erase(0, start);
+    };
+    
+    std::vector<epoll_event> ready(64);
+    while (!server_stop) {
+        int count = ::epoll_wait(poller, ready.data(), static_cast<int>(ready.size()), -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.ptr == nullptr) {
+                for (int fd; (fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0; ) {
+                    auto connection = std::make_unique<ServerConnection<T>>(fd, arithmetic);
+                    epoll_event event{};
+                    event.events = connection->events = EPOLLIN;
+                    event.data.ptr = connection.get();
+                    ::epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event);
+                    connections.emplace(fd, std::move(connection));
                 }
-                else if (token == "pow") {
-                    calc.pow();
+                continue;
+            }
+            ServerConnection<T>& connection = *static_cast<ServerConnection<T>*>(ready[i].data.ptr);
+            if (ready[i].events & EPOLLIN) {
+                ssize_t got = ::read(connection.fd, buffer.data(), buffer.size());
+                if (got > 0) {
+                    connection.input.append(buffer.data(), got);
+                    serve(connection);
+                } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    // Последний запрос без перевода строки тоже получает ответ
+                    if (got == 0 && !connection.input.empty()) {
+                        connection.input.push_back('\n');
+                        serve(connection);
+                    }
+                    connection.closing = true;
                 }
-                else if (token == "median") {
-                    calc.median();
+            } else if (ready[i].events & (EPOLLERR | EPOLLHUP)) {
+                close_connection(connection);
+                continue;
+            }
+            if (!flush(connection)) {
+                close_connection(connection);
+                continue;
+            }
+            update_events(connection);
+        }
+    }
+    
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    ::close(poller);
+    ::close(listener);
+    ::unlink(path);
+    std::cerr << "cache hits " << cache.hits() << ", misses " << cache.misses() << "\n";
+    return 0;
+}
+
+// Генератор нагрузки для runServer: connections потоков, у каждого своё
+// соединение и до pipeline запросов в полёте, всего по requests запросов.
+// Задержка запроса - от отправки до получения его строки ответа. Выражения
+// берутся по кругу из файла или из встроенного набора. Итог - одна строка
+// key=value
+inline int runLoad(const char* socket_path, const char* path, size_t connections, size_t requests, size_t pipeline) {
+    std::vector<std::string> expressions;
+    if (path) {
+        std::FILE* input = std::fopen(path, "rb");
+        if (!input) {
+            std::cout << "Cannot open " << path;
+            return 1;
+        }
+        LineReader reader(input);
+        std::string_view line;
+        while (reader.next(line)) {
+            expressions.emplace_back(line);
+        }
+        std::fclose(input);
+    }
+    if (expressions.empty()) {
+        expressions = {"1 2 +", "3 4 * 5 -", "2 sqrt 3 * 1 +", "0.5 sin 0.5 cos /", "1 2 3 median 4 pow",
+                       "10 3 / 7 log + 2 exp *", "1 0 /", "5 -1 sqrt", "1 2 3 4 5 6 7 8 + + + + + + +"};
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(address.sun_path)) {
+        std::cout << "Socket path is too long: " << socket_path;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path);
+    pipeline = std::max<size_t>(pipeline, 1);
+    
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::vector<double>> latencies(connections);
+    std::atomic<bool> failed{false};
+    auto client = [&](size_t id) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            failed = true;
+            if (fd >= 0) ::close(fd);
+            return;
+        }
+        std::vector<double>& measured = latencies[id];
+        measured.reserve(requests);
+        std::deque<Clock::time_point> in_flight;
+        std::string batch;
+        std::vector<char> buffer(1 << 16);
+        size_t sent = 0;
+        size_t next = id;
+        while (measured.size() < requests) {
+            batch.clear();
+            Clock::time_point now = Clock::now();
+            for (; sent < requests && in_flight.size() < pipeline; sent++) {
+                batch += expressions[next++ % expressions.size()];
+                batch += '\n';
+                in_flight.push_back(now);
+            }
+            for (size_t done = 0; done < batch.size(); ) {
+                ssize_t written = ::send(fd, batch.data() + done, batch.size() - done, MSG_NOSIGNAL);
+                if (written <= 0) {
+                    failed = true;
+                    ::close(fd);
+                    return;
                 }
-                else {
-                    throw std::runtime_error("Incorrect input: unknown token '" + token + "'");
+                done += written;
+            }
+            ssize_t got = ::read(fd, buffer.data(), buffer.size());
+            if (got <= 0) {
+                failed = true;
+                break;
+            }
+            Clock::time_point received = Clock::now();
+            for (ssize_t k = 0; k < got; k++) {
+                if (buffer[k] == '\n') {
+                    measured.push_back(std::chrono::duration<double, std::micro>(received - in_flight.front()).count());
+                    in_flight.pop_front();
                 }
             }
         }
-        
-        calc.print();
-        
+        ::close(fd);
+    };
+    
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t id = 0; id < connections; id++) {
+        threads.emplace_back(client, id);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (failed) {
+        std::cout << "Cannot talk to " << socket_path << "\n";
+        return 1;
+    }
+    std::vector<double> all;
+    for (const std::vector<double>& measured : latencies) {
+        all.insert(all.end(), measured.begin(), measured.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+    };
+    std::cout << "requests=" << all.size() << " connections=" << connections << " pipeline=" << pipeline
+              << " seconds=" << seconds << " throughput=" << all.size() / seconds
+              << " p50_us=" << percentile(0.50) << " p99_us=" << percentile(0.99)
+              << " p999_us=" << percentile(0.999) << " max_us=" << (all.empty() ? 0.0 : all.back()) << "\n";
+    return 0;
+}
+#endif
+
+// Параметры запуска: [--type double|float|bcd] [--precision N]
+// [--batch [--threads N] [file]]. precision - знаков после точки у bcd;
+// threads = 0 - по числу ядер, без --threads - один поток.
+// Сервер: --serve socket [--cache N]; нагрузка на него: --load socket
+// [--connections C] [--requests N] [--pipeline D] [file]
+struct Options {
+    std::string_view type = "double";
+    int precision = 20;
+    bool batch = false;
+    size_t threads = 1;
+    const char* path = nullptr;
+    const char* serve = nullptr;
+    size_t cache = 4096;
+    const char* load = nullptr;
+    size_t connections = 4;
+    size_t requests = 100000;
+    size_t pipeline = 16;
+};
+
+const char* const USAGE =
+    "Usage: HW_4_task_1 [--type double|float|bcd] [--precision N] [--batch [--threads N] [file]]\n"
+    "       HW_4_task_1 --serve socket [--cache N]\n"
+    "       HW_4_task_1 --load socket [--connections C] [--requests N] [--pipeline D] [file]\n";
+
+bool optionError(const std::string& message) {
+    std::cerr << message << "\n" << USAGE;
+    return false;
+}
+
+// Неотрицательное целое без лишних символов
+bool parseCount(std::string_view text, size_t& value) {
+    std::from_chars_result parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+    return parsed.ec == std::errc() && parsed.ptr == text.data() + text.size();
+}
+
+// Неизвестный параметр, параметр без значения (значение не может начинаться
+// с --), неверное число или второй файл - сообщение и справка в cerr, false
+bool parseOptions(int argc, char** argv, Options& options) {
+    static const std::string_view WITH_VALUE[] = {"--threads", "--type", "--precision", "--serve", "--cache",
+                                                  "--load", "--connections", "--requests", "--pipeline"};
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--batch") {
+            options.batch = true;
+            continue;
+        }
+        if (arg.substr(0, 2) != "--") {
+            if (options.path) {
+                return optionError("Unexpected argument " + std::string(arg));
+            }
+            options.path = argv[i];
+            continue;
+        }
+        if (std::find(std::begin(WITH_VALUE), std::end(WITH_VALUE), arg) == std::end(WITH_VALUE)) {
+            return optionError("Unknown option " + std::string(arg));
+        }
+        if (i + 1 >= argc || std::string_view(argv[i + 1]).substr(0, 2) == "--") {
+            return optionError("Missing value for " + std::string(arg));
+        }
+        const char* value = argv[++i];
+        bool valid = true;
+        if (arg == "--threads") {
+            valid = parseCount(value, options.threads);
+            if (options.threads == 0) {
+                options.threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+        } else if (arg == "--type") {
+            options.type = value;
+            valid = options.type == "double" || options.type == "float" || options.type == "bcd";
+        } else if (arg == "--precision") {
+            size_t precision = 0;
+            valid = parseCount(value, precision) && precision <= static_cast<size_t>(INT_MAX);
+            options.precision = static_cast<int>(precision);
+        } else if (arg == "--serve") {
+            options.serve = value;
+        } else if (arg == "--cache") {
+            valid = parseCount(value, options.cache);
+        } else if (arg == "--load") {
+            options.load = value;
+        } else if (arg == "--connections") {
+            valid = parseCount(value, options.connections);
+        } else if (arg == "--requests") {
+            valid = parseCount(value, options.requests);
+        } else if (arg == "--pipeline") {
+            valid = parseCount(value, options.pipeline);
+        }
+        if (!valid) {
+            return optionError("Invalid value " + std::string(value) + " for " + std::string(arg));
+        }
+    }
+    return true;
+}
+
+// Одна строка из stdin или пакетный режим в числах типа T
+template <typename T>
+int run(const Options& options, const Arithmetic<T>& arithmetic) {
+#if defined(__linux__)
+    if (options.serve) {
+        return runServer(options.serve, options.cache, arithmetic);
+    }
+#endif
+    if (options.batch) {
+        std::FILE* input = options.path ? std::fopen(options.path, "rb") : stdin;
+        if (!input) {
+            std::cout << "Cannot open " << options.path;
+            return 1;
+        }
+        int code = options.threads > 1 ? runParallelBatch(input, options.threads, arithmetic) : runBatch(input, arithmetic);
+        if (options.path) {
+            std::fclose(input);
+        }
+        return code;
+    }
+    
+    std::string input_line;
+    std::getline(std::cin, input_line);
+    
+    BasicCalculator<T> calc(arithmetic);
+    
+    try {
+        BasicProgram<T> program = BasicProgram<T>::compile(input_line, {}, arithmetic);
+        std::cout << calc.evaluate(program);
     } catch (const std::exception& e) {
         std::cout << e.what();
         return 1;
@@ -256,3 +771,23 @@ int main() {
     
     return 0;
 }
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+#if defined(__linux__)
+    if (options.load) {
+        return runLoad(options.load, options.path, options.connections, options.requests, options.pipeline);
+    }
+#endif
+    if (options.type == "double") {
+        return run(options, Arithmetic<double>());
+    }
+    if (options.type == "float") {
+        return run(options, Arithmetic<float>());
+    }
+    // Прочие типы отвергнуты в parseOptions
+    return run(options, Arithmetic<BCD>(options.precision));
+}
@@ -1,405 +1,399 @@
-#include <iostream>
-#include <string>
-#include <cassert>
-#include <cmath>
-#include <algorithm>
-#include <vector>
+#include "BCD.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-class BCD {
+BCD calculateReciprocal(long long N, int precision) {
+    assert(N != 0);
+    return BCD::reciprocal(N, precision);
+}
+
+// Файл только для чтения, отображённый в память
+class MappedFile {
 public:
-    BCD(std::string str = "0") {
-        if (str.empty()) str = "0";
-        
-        if (str[0] == '-') {
-            is_negative = true;
-            str = str.substr(1);
+    explicit MappedFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("BCD: cannot open " + path);
         }
-        
-        size_t comma_pos = str.find(',');
-        if (comma_pos != std::string::npos) {
-            str[comma_pos] = '.';
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("BCD: cannot stat " + path);
         }
-        
-        // Разделение на целую и дробную части
-        size_t dot_pos = str.find('.');
-        if (dot_pos == std::string::npos) {
-            integer_part = std::stoul(str);
-            fractional_part = "";
-        } else {
-            integer_part = std::stoul(str.substr(0, dot_pos));
-            fractional_part = str.substr(dot_pos + 1);
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("BCD: cannot map " + path);
+            }
+            ::madvise(mapped, length, MADV_SEQUENTIAL);
+            begin = static_cast<const char*>(mapped);
         }
-        
-        assert(std::to_string(integer_part).length() <= 10);
-    }
-
-    BCD(int l, std::string r = "") : integer_part(std::abs(l)), fractional_part(r), is_negative(l < 0) {
-        assert(std::to_string(integer_part).length() <= 10);
-    }
-    
-    BCD() : integer_part(0), fractional_part(""), is_negative(false) {}
-    
-    BCD(const BCD& other) = default;
-    
-    BCD(BCD&& other) noexcept
-        : integer_part(std::move(other.integer_part))
-        , fractional_part(std::move(other.fractional_part))
-        , is_negative(std::move(other.is_negative)) {}
-
-    BCD& operator=(BCD&& other) noexcept {
-        integer_part = std::move(other.integer_part);
-        fractional_part = std::move(other.fractional_part);
-        is_negative = std::move(other.is_negative);
-        return *this;
-    }
-    
-    BCD& operator=(const BCD& other) = default;
-    
-    int ceil() const {
-        if (fractional_part.empty() || is_zero_fractional()) {
-            return is_negative ? -static_cast<int>(integer_part) : static_cast<int>(integer_part);
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("BCD: cannot open " + path);
         }
-        return is_negative ? -static_cast<int>(integer_part) : static_cast<int>(integer_part) + 1;
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        begin = buffer.data();
+        length = buffer.size();
+#endif
     }
     
-    int floor() const {
-        if (fractional_part.empty() || is_zero_fractional()) {
-            return is_negative ? -static_cast<int>(integer_part) : static_cast<int>(integer_part);
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (begin) {
+            ::munmap(const_cast<char*>(begin), length);
         }
-        return is_negative ? -static_cast<int>(integer_part) - 1 : static_cast<int>(integer_part);
+#endif
     }
     
-    int round() const {
-        if (fractional_part.empty() || is_zero_fractional()) {
-            return is_negative ? -static_cast<int>(integer_part) : static_cast<int>(integer_part);
-        }
-        
-        int first_digit = fractional_part[0] - '0';
-        if (first_digit >= 5) {
-            return is_negative ? -static_cast<int>(integer_part) - 1 : static_cast<int>(integer_part) + 1;
-        }
-        return is_negative ? -static_cast<int>(integer_part) : static_cast<int>(integer_part);
-    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
     
-    BCD operator+(const BCD& other) const {
-        if (is_negative == other.is_negative) {
-            return add_same_sign(*this, other);
-        } else {
-            return add_different_sign(*this, other);
-        }
+    const char* data() const {
+        return begin;
     }
     
-    BCD& operator+=(const BCD& other) {
-        *this = *this + other;
-        return *this;
+    size_t size() const {
+        return length;
     }
     
-    BCD operator-(const BCD& other) const {
-        return *this + (-other);
+private:
+    const char* begin = nullptr;
+    size_t length = 0;
+#if !(defined(__unix__) || defined(__APPLE__))
+    std::string buffer;
+#endif
+};
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Вызывает fn(first, last) для каждой строки [from, to) без \n, у которой
+// отрезаны пробелы, табуляции и \r по краям; пустые после этого строки пропускаются
+template <typename F>
+void forEachLine(const char* from, const char* to, F&& fn) {
+    while (from < to) {
+        const char* eol = static_cast<const char*>(std::memchr(from, '\n', to - from));
+        if (!eol) eol = to;
+        const char* start = from;
+        const char* stop = eol;
+        while (start < stop && isBlank(*start)) start++;
+        while (stop > start && isBlank(stop[-1])) stop--;
+        if (stop > start) {
+            fn(start, stop);
+        }
+        from = eol + 1;
     }
-    
-    BCD& operator-=(const BCD& other) {
-        *this = *this - other;
-        return *this;
+}
+
+// Столбец чисел из файла с одним числом в строке. Пробелы и табуляции вокруг
+// числа и окончания \r\n допускаются, пустые и пробельные строки пропускаются,
+// любой другой лишний символ - invalid_argument. Разбор идёт прямо из отображённой памяти:
+// файл режется на куски по границам строк, первый проход считает строки
+// в кусках, второй разбирает каждый кусок в свой отрезок столбца.
+// При включённом пуле потоков куски обрабатываются параллельно
+std::vector<BCD> loadDecimalColumn(const std::string& path) {
+    const size_t CHUNK_BYTES = 1 << 20;
+    MappedFile file(path);
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    size_t chunks = std::max<size_t>(1, file.size() / CHUNK_BYTES);
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = begin;
+    for (size_t c = 1; c < chunks; c++) {
+        const char* p = std::max(begin + file.size() / chunks * c, bounds[c - 1]);
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        bounds[c] = eol ? eol + 1 : end;
     }
     
-    BCD operator*(const BCD& other) const {
-        if (is_zero() || other.is_zero()) {
-            return BCD(0, "");
+    std::vector<size_t> offsets(chunks + 1, 0);
+    bcd_parallel::parallel_for(0, chunks, 1, [&](size_t from, size_t to) {
+        for (size_t c = from; c < to; c++) {
+            forEachLine(bounds[c], bounds[c + 1], [&](const char*, const char*) { offsets[c + 1]++; });
         }
-        
-        bool result_negative = (is_negative != other.is_negative);
-        
-        // Преобразуем в строки без учета знака
-        std::string a_str = std::to_string(integer_part) + fractional_part;
-        std::string b_str = std::to_string(other.integer_part) + other.fractional_part;
-        
-        // Удаляем ведущие нули, но сохраняем хотя бы одну цифру
-        a_str = a_str.erase(0, std::min(a_str.find_first_not_of('0'), a_str.size() - 1));
-        b_str = b_str.erase(0, std::min(b_str.find_first_not_of('0'), b_str.size() - 1));
-        
-        int total_decimal_places = get_precision() + other.get_precision();
-        
-        int n = a_str.length();
-        int m = b_str.length();
-        std::vector<int> result(n + m, 0);
-        
-        for (int i = n - 1; i >= 0; i--) {
-            for (int j = m - 1; j >= 0; j--) {
-                int mul = (a_str[i] - '0') * (b_str[j] - '0');
-                int sum = mul + result[i + j + 1];
-                
-                result[i + j + 1] = sum % 10;
-                result[i + j] += sum / 10;
-            }
-        }
-        
-        // Преобразуем в строку
-        std::string result_str;
-        for (int num : result) {
-            if (!(result_str.empty() && num == 0)) {
-                result_str.push_back(num + '0');
-            }
-        }
-        
-        if (result_str.empty()) {
-            return BCD(0, "");
-        }
-        
-        // Разделяем на целую и дробную части
-        std::string integer_str, fractional_str;
-        if (total_decimal_places >= static_cast<int>(result_str.length())) {
-            integer_str = "0";
-            fractional_str = std::string(total_decimal_places - result_str.length(), '0') + result_str;
-        } else {
-            integer_str = result_str.substr(0, result_str.length() - total_decimal_places);
-            fractional_str = result_str.substr(result_str.length() - total_decimal_places);
-        }
-        
-        int result_int = std::stoi(integer_str);
-        
-        // Вычисляем новую точность
-        int M = std::max(integer_part, other.integer_part);
-        int log_term = (M == 0) ? 0 : static_cast<int>(std::log10(M)) + 1;
-        int new_precision = std::min(get_precision(), other.get_precision()) - (1 + log_term);
-        if (new_precision < 0) new_precision = 0;
-        
-        // Обрезаем дробную часть до новой точности
-        if (new_precision < static_cast<int>(fractional_str.length())) {
-            fractional_str = fractional_str.substr(0, new_precision);
-        }
-        
-        BCD result_bcd(result_negative ? -result_int : result_int, fractional_str);
-        return result_bcd;
+    });
+    for (size_t c = 0; c < chunks; c++) {
+        offsets[c + 1] += offsets[c];
     }
     
-    BCD operator*=(const BCD& other) {
-        *this = *this * other;
-        return *this;
-    }
-    
-    BCD operator+() const {
-        return *this;
+    std::vector<BCD> column(offsets[chunks]);
+    bcd_parallel::parallel_for(0, chunks, 1, [&](size_t from, size_t to) {
+        for (size_t c = from; c < to; c++) {
+            BCD* out = column.data() + offsets[c];
+            forEachLine(bounds[c], bounds[c + 1], [&](const char* first, const char* last) {
+                std::from_chars_result parsed = from_chars(first, last, *out++);
+                if (parsed.ec != std::errc() || parsed.ptr != last) {
+                    throw std::invalid_argument("BCD: invalid number \"" + std::string(first, last) + "\"");
+                }
+            });
+        }
+    });
+    return column;
+}
+
+// Столбец в двоичный файл формата BCDBinaryWriter: перечитывается без разбора
+// текста, а длинные числа занимают 4 байта на 9 цифр вместо 9
+void saveBinaryColumn(const std::string& path, const std::vector<BCD>& column) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("BCD: cannot open " + path);
     }
-    
-    BCD operator-() const {
-        BCD result = *this;
-        if (!result.is_zero()) {
-            result.is_negative = !result.is_negative;
+    BCDBinaryWriter writer(out);
+    writer.write(column.data(), column.size());
+    writer.finish();
+}
+
+// Файл отображается в память, записи копируются из него на месте
+std::vector<BCD> loadBinaryColumn(const std::string& path) {
+    MappedFile file(path);
+    return BCDBinaryReader(file.data(), file.size()).load();
+}
+
+// Ряд S = sum_{k=0}^{n-1} a(k) / b(k) * p(0) * ... * p(k) / (q(0) * ... * q(k)),
+// который суммируется двоичным разбиением: все частичные суммы - целые BCD,
+// а единственное деление выполняется в конце. Для рядов с членами полиномиальной
+// высоты это даёт O(M(N) log^2 N) вместо O(N^2) на почленное сложение.
+class BinarySplittingSeries {
+public:
+    using Term = std::function<BCD(long long)>;
+    
+    // S(n1, n2) = T / (B * Q)
+    struct Sums {
+        BCD P, Q, B, T;
+    };
+    
+    // b может быть пустым - тогда b(k) = 1 и произведения B не считаются
+    BinarySplittingSeries(Term a, Term b, Term p, Term q)
+        : a(std::move(a)), b(std::move(b)), p(std::move(p)), q(std::move(q)) {}
+    
+    Sums evaluate(long long n1, long long n2) const {
+        assert(n1 < n2);
+        Sums result;
+        if (n2 - n1 == 1) {
+            result.P = p(n1);
+            result.Q = q(n1);
+            result.B = b ? b(n1) : BCD(1);
+            result.T = a(n1) * result.P;
+            return result;
         }
+        long long middle = n1 + (n2 - n1) / 2;
+        Sums left, right;
+        bool split = n2 - n1 >= bcd_parallel::parallel_config.min_terms;
+        run(split, [&] { left = evaluate(n1, middle); }, [&] { right = evaluate(middle, n2); });
+        
+        // Произведения слияния независимы и тоже считаются параллельно
+        BCD t_left, t_right;
+        result.B = BCD(1);
+        run(split,
+            [&] { result.P = left.P * right.P; },
+            [&] { result.Q = left.Q * right.Q; },
+            [&] { t_left = b ? right.B * right.Q * left.T : right.Q * left.T; },
+            [&] { t_right = b ? left.B * left.P * right.T : left.P * right.T; },
+            [&] { if (b) result.B = left.B * right.B; });
+        result.T = t_left + t_right;
         return result;
     }
     
-    // Операторы сравнения
-    bool operator==(const BCD& other) const {
-        if (is_negative != other.is_negative) return false;
-        if (integer_part != other.integer_part) return false;
-        
-        std::string a_frac = fractional_part;
-        std::string b_frac = other.fractional_part;
-        //Выравниваем дробные части
-        align_fractions(a_frac, b_frac);
-        return a_frac == b_frac;
+    // Сумма первых terms членов с precision знаками после точки
+    BCD sum(long long terms, int precision) const {
+        Sums sums = evaluate(0, terms);
+        return sums.T.divide(b ? sums.B * sums.Q : sums.Q, precision);
     }
     
-    bool operator!=(const BCD& other) const {
-        return !(*this == other);
-    }
+private:
+    Term a, b, p, q;
     
-    bool operator<(const BCD& other) const {
-        if (is_negative != other.is_negative) {
-            return is_negative;
-        }
-        
-        if (integer_part != other.integer_part) {
-            return is_negative ? integer_part > other.integer_part : integer_part < other.integer_part;
+    template <typename... F>
+    static void run(bool parallel, F&&... tasks) {
+        if (parallel) {
+            bcd_parallel::invoke(std::forward<F>(tasks)...);
+        } else {
+            (tasks(), ...);
         }
-        
-        std::string a_frac = fractional_part;
-        std::string b_frac = other.fractional_part;
-        //Выравниваем
-        align_fractions(a_frac, b_frac);
-        
-        return is_negative ? a_frac > b_frac : a_frac < b_frac;
     }
-    
-    bool operator>(const BCD& other) const {
-        return other < *this;
-    }
-    
-    bool operator<=(const BCD& other) const {
-        return !(other < *this);
-    }
-    
-    bool operator>=(const BCD& other) const {
-        return !(*this < other);
-    }
-    
-    int get_precision() const {
-        return fractional_part.length();
-    }
-    
-    bool is_zero() const {
-        return integer_part == 0 && is_zero_fractional();
-    }
-    
-    // Метод для установки точности
-    void set_precision(int precision) {
-        if (precision < 0) precision = 0;
-        if (fractional_part.length() < precision) {
-            fractional_part += std::string(precision - fractional_part.length(), '0');
-        } else if (fractional_part.length() > precision) {
-            fractional_part = fractional_part.substr(0, precision);
-        }
+};
+
+// Запасные цифры для констант: результат считается с ними и затем усекается
+const int SERIES_GUARD_DIGITS = 20;
+
+// e = sum 1 / k!
+BCD calculateE(int digits) {
+    // Число членов: k! > 10^(digits + guard)
+    double log10_factorial = 0;
+    long long terms = 1;
+    while (log10_factorial <= digits + SERIES_GUARD_DIGITS) {
+        log10_factorial += std::log10(static_cast<double>(terms));
+        terms++;
     }
-    
-    friend std::ostream& operator<<(std::ostream& os, const BCD& bcd) {
-        if (bcd.is_negative && !bcd.is_zero()) {
-            os << '-';
-        }
-        os << bcd.integer_part;
-        if (!bcd.fractional_part.empty()) {
-            os << '.' << bcd.fractional_part;
-        }
-        return os;
+    BinarySplittingSeries series(
+        [](long long) { return BCD(1); },
+        nullptr,
+        [](long long) { return BCD(1); },
+        [](long long k) { return k == 0 ? BCD(1) : BCD(std::to_string(k)); });
+    BCD e = series.sum(terms, digits + SERIES_GUARD_DIGITS);
+    e.set_precision(digits);
+    return e;
+}
+
+// Формула Чудновских: pi = 426880 * sqrt(10005) / S, ~14.18 цифр на член
+BCD calculatePi(int digits) {
+    const int precision = digits + SERIES_GUARD_DIGITS;
+    long long terms = static_cast<long long>(precision / 14.181647462725477) + 2;
+    const BCD C3_OVER_24("10939058860032000");
+    BinarySplittingSeries series(
+        [](long long k) { return BCD(std::to_string(13591409 + 545140134 * k)); },
+        nullptr,
+        [](long long k) {
+            if (k == 0) return BCD(1);
+            return BCD(std::to_string(-(6 * k - 5))) * BCD(std::to_string(2 * k - 1)) * BCD(std::to_string(6 * k - 1));
+        },
+        [&C3_OVER_24](long long k) {
+            if (k == 0) return BCD(1);
+            BCD kk(std::to_string(k));
+            return kk * kk * kk * C3_OVER_24;
+        });
+    BinarySplittingSeries::Sums sums = series.evaluate(0, terms);
+    BCD scaled = (BCD(426880) * sums.Q).divide(sums.T, precision);
+    BCD root = BCD::sqrt(BCD(10005), precision);
+    BCD pi = scaled * root;
+    pi.set_precision(digits);
+    return pi;
+}
+
+// ln 2 = 3/4 * sum (-1)^k (k!)^2 / (2^k (2k + 1)!), ~0.9 цифры на член
+BCD calculateLn2(int digits) {
+    const int precision = digits + SERIES_GUARD_DIGITS;
+    long long terms = static_cast<long long>(precision / std::log10(8.0)) + 2;
+    BinarySplittingSeries series(
+        [](long long) { return BCD(1); },
+        nullptr,
+        [](long long k) { return k == 0 ? BCD(1) : BCD(std::to_string(-k)); },
+        [](long long k) { return k == 0 ? BCD(1) : BCD(std::to_string(4 * (2 * k + 1))); });
+    BinarySplittingSeries::Sums sums = series.evaluate(0, terms);
+    BCD ln2 = (BCD(3) * sums.T).divide(BCD(4) * sums.Q, precision);
+    ln2.set_precision(digits);
+    return ln2;
+}
+
+// Проверки демонстрации: при расхождении - сообщение в cerr, и main вернёт 1
+bool check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "Ошибка проверки: " << what << "\n";
     }
-    unsigned integer_part = 0;
-    std::string fractional_part = "";
-    bool is_negative = false;
-private:
-    
-    bool is_zero_fractional() const {
-        for (char c : fractional_part) {
-            if (c != '0') return false;
-        }
-        return true;
+    return ok;
+}
+
+// Ряды двоичного разбиения сверяются с BCD::exp, BCD::pi и BCD::log
+bool checkSeries(int digits) {
+    bool ok = check(calculateE(digits) == BCD::exp(BCD(1), digits), "e рядом != BCD::exp(1)");
+    ok = check(calculatePi(digits) == BCD::pi(digits), "pi рядом != BCD::pi") && ok;
+    ok = check(calculateLn2(digits) == BCD::log(BCD(2), digits), "ln 2 рядом != BCD::log(2)") && ok;
+    return ok;
+}
+
+// 10^1000000 с точностью 30, как в калькуляторе: нулевые дробные лимбы
+// основания не должны уводить точную степень в ряд для e^(y ln x)
+bool checkPower() {
+    BCD base(10);
+    BCD exponent(1000000);
+    base.set_precision(30);
+    exponent.set_precision(30);
+    BCD expected("1" + std::string(1000000, '0'));
+    expected.set_precision(30);
+    return check(BCD::pow(base, exponent, 30) == expected, "10^1000000 с точностью 30");
+}
+
+static void writeFile(const std::string& path, const std::string& text) {
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+    if (!out) {
+        throw std::runtime_error("BCD: cannot write " + path);
     }
-    //Метод для выравнивания дробных частей
-    static void align_fractions(std::string& a, std::string& b) {
-        size_t max_len = std::max(a.length(), b.length());
-        a.append(max_len - a.length(), '0');
-        b.append(max_len - b.length(), '0');
+}
+
+static bool sameColumn(const std::vector<BCD>& a, const std::vector<BCD>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i] != b[i] || a[i].get_precision() != b[i].get_precision()) return false;
     }
-    //2 Метода для сложения чисел
-    static BCD add_same_sign(const BCD& a, const BCD& b) {
-        std::string a_frac = a.fractional_part;
-        std::string b_frac = b.fractional_part;
-        align_fractions(a_frac, b_frac);
-        
-        std::string result_frac;
-        int carry = 0;
+    return true;
+}
 
-        for (int i = a_frac.length() - 1; i >= 0; i--) {
-            int sum = (a_frac[i] - '0') + (b_frac[i] - '0') + carry;
-            result_frac.push_back((sum % 10) + '0');
-            carry = sum / 10;
-        }
-        std::reverse(result_frac.begin(), result_frac.end());
-        auto result_int = a.integer_part + b.integer_part + carry;
-        
-        int new_precision = std::min(a.get_precision(), b.get_precision()) - 1;
-        if (new_precision < 0) new_precision = 0;
-        
-        if (new_precision < static_cast<int>(result_frac.length())) {
-            result_frac = result_frac.substr(0, new_precision);
-        }
-        
-        BCD result(0, result_frac);
-        result.integer_part = result_int;
-        result.is_negative = a.is_negative;
-        return result;
+// Загрузчик столбца: маленький файл с \r\n, пробелами и пустыми строками
+// и файл в несколько мегабайт, который режется на куски и разбирается в 4 потока
+bool checkDecimalColumn(const std::string& path) {
+    writeFile(path, "1.5\r\n\r\n  -2,25\t\n   \n0\r\n.5");
+    bool ok = check(sameColumn(loadDecimalColumn(path), {BCD("1.5"), BCD("-2.25"), BCD("0"), BCD(".5")}),
+                    "маленький столбец");
+    
+    std::vector<BCD> expected;
+    std::string text;
+    for (int i = 0; i < 300000; i++) {
+        std::string number = (i % 3 == 0 ? "-" : "") + std::to_string(i * 7919LL % 1000003) + "." + std::to_string(i);
+        text += number + (i % 2 == 0 ? "\r\n" : "\n");
+        expected.emplace_back(number);
     }
-    
-    static BCD add_different_sign(const BCD& a, const BCD& b) {
-        // Определяем число с большим абсолютным значением
-        BCD abs_a = a;
-        abs_a.is_negative = false;
-        BCD abs_b = b;
-        abs_b.is_negative = false;
-        
-        if (abs_a == abs_b) {
-            return BCD(0, "");
-        }
-        
-        bool result_negative;
-        const BCD* larger;
-        const BCD* smaller;
-        
-        if (abs_a > abs_b) {
-            larger = &a;
-            smaller = &b;
-            result_negative = a.is_negative;
-        } else {
-            larger = &b;
-            smaller = &a;
-            result_negative = b.is_negative;
-        }
-        
-        std::string larger_frac = larger->fractional_part;
-        std::string smaller_frac = smaller->fractional_part;
-        align_fractions(larger_frac, smaller_frac);
-        
-        std::string result_frac;
-        int borrow = 0;
-        
-        // Вычитаем дробные части
-        for (int i = larger_frac.length() - 1; i >= 0; i--) {
-            int diff = (larger_frac[i] - '0') - (smaller_frac[i] - '0') - borrow;
-            if (diff < 0) {
-                diff += 10;
-                borrow = 1;
-            } else {
-                borrow = 0;
-            }
-            result_frac.push_back(diff + '0');
-        }
-        std::reverse(result_frac.begin(), result_frac.end());
-        
-        unsigned result_int = larger->integer_part - smaller->integer_part - borrow;
-        
-        // Вычисляем новую точность
-        int new_precision = std::min(a.get_precision(), b.get_precision()) - 1;
-        if (new_precision < 0) new_precision = 0;
-        
-        // Обрезаем дробную часть до новой точности
-        if (new_precision < static_cast<int>(result_frac.length())) {
-            result_frac = result_frac.substr(0, new_precision);
-        }
-        
-        BCD result(0, result_frac);
-        result.integer_part = result_int;
-        result.is_negative = result_negative;
-        return result;
+    writeFile(path, text);
+    bcd_parallel::set_threads(4);
+    ok = check(sameColumn(loadDecimalColumn(path), expected), "столбец из нескольких кусков") && ok;
+    bcd_parallel::set_threads(1);
+    
+    writeFile(path, "1\n1.2.3\n");
+    try {
+        loadDecimalColumn(path);
+        ok = check(false, "строка 1.2.3 принята");
+    } catch (const std::invalid_argument&) {
     }
-};
+    std::remove(path.c_str());
+    return ok;
+}
 
-BCD calculateReciprocal(long long N, int precision) {
-    assert(N != 0);
-    
-    if (N == 1) return BCD(1, std::string(precision, '0'));
-    if (N == -1) return BCD(-1, std::string(precision, '0'));
-    
-    bool result_negative = N < 0;
-    N = std::abs(N);
-    
-    std::string fractional;
-    long long remainder = 1;
-    
-    for (int i = 0; i < precision; i++) {
-        if (remainder == 0) {
-            fractional += '0';
-            continue;
+// Чтение файла целиком - для порчи двоичного столбца
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Двоичный столбец: запись, чтение через отображение и отказ на обрезанном
+// файле и на испорченном индексе
+bool checkBinaryColumn(const std::string& path) {
+    std::vector<BCD> column = {BCD(0), BCD("-1.5"), BCD("123456789012345678901234567890.000"),
+                               BCD("-0.000000001"), calculateReciprocal(7, 1000)};
+    saveBinaryColumn(path, column);
+    bool ok = check(sameColumn(loadBinaryColumn(path), column), "двоичный столбец после записи и чтения");
+    
+    std::string bytes = readFile(path);
+    auto rejected = [&](const std::string& corrupted) {
+        writeFile(path, corrupted);
+        try {
+            loadBinaryColumn(path);
+        } catch (const std::runtime_error&) {
+            return true;
         }
-        
-        remainder *= 10;
-        int digit = remainder / N;
-        remainder %= N;
-        fractional += std::to_string(digit);
-    }
-    
-    BCD result(0, fractional);
-    result.is_negative = result_negative;
-    return result;
+        return false;
+    };
+    ok = check(rejected(bytes.substr(0, bytes.size() - 5)), "обрезанный двоичный столбец принят") && ok;
+    // Индекс - перед 16 байтами хвоста; смещение последней записи уводится за файл
+    std::string corrupted = bytes;
+    uint64_t offset = bytes.size() * 2;
+    std::memcpy(&corrupted[bytes.size() - 16 - sizeof(offset)], &offset, sizeof(offset));
+    ok = check(rejected(corrupted), "двоичный столбец с испорченным индексом принят") && ok;
+    std::remove(path.c_str());
+    return ok;
 }
 
 int main() {
@@ -423,18 +417,28 @@ int main() {
     const int computation_precision = 400;
     BCD sum(1);
     BCD term(1);
+    BCD recip_n;
     int n = 1;
     sum.set_precision(computation_precision);
     term.set_precision(computation_precision);
+    //Временные лимбы цикла берутся из пула, term и sum считаются на месте
+    bcd_limbs::set_pooling(true);
     //n = 71 было рассчитано
     while (n < 71) {
-        BCD recip_n = calculateReciprocal(n, computation_precision);
-        term = term * recip_n;
-        BCD old_sum = sum;
-        sum = old_sum +  term;
+        recip_n = calculateReciprocal(n, computation_precision);
+        term *= recip_n;
+        sum += term;
         n++;
     }
     sum.set_precision(target_precision);
-    std::cout << "e = " << sum <<" " <<sum.fractional_part.length()<<"\n";
-    return 0;
+    std::cout << "e = " << sum <<" " <<sum.get_precision()<<"\n";
+    
+    bool ok = checkSeries(target_precision);
+    ok = checkPower() && ok;
+    std::string column_path = (std::filesystem::temp_directory_path() / "HW_4_task_2_column").string();
+    ok = checkDecimalColumn(column_path + ".txt") && ok;
+    ok = checkBinaryColumn(column_path + ".bin") && ok;
+    std::cout << "pi = " << calculatePi(target_precision) << "\n";
+    std::cout << "ln 2 = " << calculateLn2(target_precision) << "\n";
+    return ok ? 0 : 1;
 }
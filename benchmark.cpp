@@ -0,0 +1,435 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "Calculator.h"
+
+// Замеры горячих путей BCD и калькулятора. Каждый замер повторяет операцию,
+// удваивая число повторов, пока серия не займёт --min-time секунд, и печатает
+// строку CSV: имя, параметр (цифр у BCD, операций в строке у калькулятора),
+// повторы, нс на операцию, операций в секунду и выделений памяти на операцию.
+// Параметры: [--filter подстрока] [--min-time секунды] [--max-digits N]
+
+// Счётчик выделений: замена глобального operator new только в этой программе
+namespace {
+std::atomic<size_t> allocation_count{0};
+}
+
+void* operator new(size_t bytes) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes ? bytes : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC принимает free внутри заменённого operator delete за парную ошибку
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+struct BenchmarkOptions {
+    std::string filter;
+    double min_time = 0.2;
+    int max_digits = 100000;
+};
+
+// Результат не должен выбрасываться оптимизатором
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions& options) : options(options) {
+        std::cout << "benchmark,param,iterations,ns_per_op,ops_per_sec,allocs_per_op\n";
+    }
+    
+    // body(iterations) выполняет операцию iterations раз
+    template <typename F>
+    void run(const std::string& name, long long param, F&& body) {
+        if (name.find(options.filter) == std::string::npos) return;
+        body(1);  // прогрев: буферы, пулы, ленивые таблицы
+        for (size_t iterations = 1; ; iterations *= 2) {
+            size_t allocations = allocation_count.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            allocations = allocation_count.load(std::memory_order_relaxed) - allocations;
+            if (seconds >= options.min_time) {
+                std::cout << name << ',' << param << ',' << iterations << ','
+                          << seconds * 1e9 / iterations << ',' << iterations / seconds << ','
+                          << static_cast<double>(allocations) / iterations << '\n';
+                return;
+            }
+        }
+    }
+
+private:
+    BenchmarkOptions options;
+};
+
+// Число из digits случайных цифр: одна целая, остальные после точки
+std::string randomDecimal(std::mt19937_64& rng, int digits, bool negative = false) {
+    std::string text = negative ? "-" : "";
+    text += static_cast<char>('1' + rng() % 9);
+    if (digits > 1) {
+        text += '.';
+        for (int i = 1; i < digits; i++) {
+            text += static_cast<char>('0' + rng() % 10);
+        }
+    }
+    return text;
+}
+
+void benchmarkBCD(BenchmarkRunner& runner, const BenchmarkOptions& options) {
+    std::mt19937_64 rng(42);
+    for (int digits = 10; digits <= options.max_digits; digits *= 10) {
+        std::string a_text = randomDecimal(rng, digits);
+        std::string b_text = randomDecimal(rng, digits);
+        BCD a(a_text);
+        BCD b(b_text);
+        // Отличается только последней цифрой: сравнение проходит все лимбы
+        std::string c_text = a_text;
+        c_text.back() = c_text.back() == '9' ? '8' : '9';
+        BCD c(c_text);
+        
+        runner.run("bcd_add", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(a + b);
+        });
+        runner.run("bcd_add_assign", digits, [&](size_t n) {
+            BCD sum = a;
+            for (size_t i = 0; i < n; i++) {
+                sum += b;
+                sum.set_precision(digits);
+            }
+            keep(sum);
+        });
+        runner.run("bcd_multiply", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(a * b);
+        });
+        runner.run("bcd_compare", digits, [&](size_t n) {
+            bool less = false;
+            for (size_t i = 0; i < n; i++) {
+                less ^= a < c;
+                keep(less);
+            }
+        });
+        runner.run("bcd_equal", digits, [&](size_t n) {
+            bool equal = false;
+            for (size_t i = 0; i < n; i++) {
+                equal ^= a == c;
+                keep(equal);
+            }
+        });
+        // calculateReciprocal из HW_4_task_2.cpp - обёртка над BCD::reciprocal
+        runner.run("bcd_reciprocal", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(BCD::reciprocal(345671, digits));
+        });
+        runner.run("bcd_divide", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(a.divide(b, digits));
+        });
+        runner.run("bcd_sqrt", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(BCD::sqrt(a, digits));
+        });
+        // Элементарные функции на 100000 цифрах идут десятки секунд на вызов
+        if (digits <= 10000) {
+            runner.run("bcd_exp", digits, [&](size_t n) {
+                for (size_t i = 0; i < n; i++) keep(BCD::exp(a, digits));
+            });
+            runner.run("bcd_log", digits, [&](size_t n) {
+                for (size_t i = 0; i < n; i++) keep(BCD::log(a, digits));
+            });
+            runner.run("bcd_sin", digits, [&](size_t n) {
+                for (size_t i = 0; i < n; i++) keep(BCD::sin(a, digits));
+            });
+            runner.run("bcd_atan", digits, [&](size_t n) {
+                for (size_t i = 0; i < n; i++) keep(BCD::atan(a, digits));
+            });
+        }
+        runner.run("bcd_parse", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(BCD(std::string_view(a_text)));
+        });
+        std::vector<char> binary(a.binary_size());
+        runner.run("bcd_to_binary", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(a.to_binary(binary.data()));
+        });
+        runner.run("bcd_from_binary", digits, [&](size_t n) {
+            BCD value;
+            for (size_t i = 0; i < n; i++) {
+                keep(from_binary(binary.data(), binary.data() + binary.size(), value));
+            }
+        });
+        runner.run("bcd_print", digits, [&](size_t n) {
+            std::ostringstream out;
+            for (size_t i = 0; i < n; i++) {
+                out.str("");
+                out << a;
+                keep(out);
+            }
+        });
+        std::vector<char> text(a.formatted_size());
+        runner.run("bcd_to_chars", digits, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) keep(to_chars(text.data(), text.data() + text.size(), a));
+        });
+    }
+}
+
+// Операции над столбцом: параметр - цифр в числе, время - на строку. Цепочка
+// operator+= возвращает точность после каждого сложения, иначе она падает.
+// Сортировки каждый раз получают свежую копию столбца
+void benchmarkColumns(BenchmarkRunner& runner) {
+    std::mt19937_64 rng(11);
+    size_t rows = 1 << 16;
+    for (int digits : {10, 30, 100}) {
+        std::vector<BCD> a, b;
+        for (size_t i = 0; i < rows; i++) {
+            a.emplace_back(randomDecimal(rng, digits, rng() % 2 == 0));
+            b.emplace_back(randomDecimal(rng, digits));
+        }
+        int precision = digits - 1;
+        runner.run("bcd_sum_chained", digits, [&](size_t n) {
+            BCD total;
+            for (size_t i = 0; i < n; i++) {
+                total += a[i % rows];
+                total.set_precision(precision);
+            }
+            keep(total);
+        });
+        runner.run("bcd_sum", digits, [&](size_t n) {
+            for (size_t done = 0; done < n; done += rows) {
+                keep(BCD::sum(a.data(), std::min(rows, n - done)));
+            }
+        });
+        runner.run("bcd_dot_chained", digits, [&](size_t n) {
+            BCD total;
+            for (size_t i = 0; i < n; i++) {
+                BCD product = a[i % rows] * b[i % rows];
+                product.set_precision(2 * precision);
+                total += product;
+                total.set_precision(2 * precision);
+            }
+            keep(total);
+        });
+        runner.run("bcd_dot", digits, [&](size_t n) {
+            for (size_t done = 0; done < n; done += rows) {
+                keep(BCD::dot(a.data(), b.data(), std::min(rows, n - done)));
+            }
+        });
+        // Столбец в строку: по одному operator<< и буфером BCDTextWriter
+        runner.run("bcd_column_ostream", digits, [&](size_t n) {
+            std::ostringstream out;
+            for (size_t i = 0; i < n; i++) {
+                out << a[i % rows] << '\n';
+            }
+            keep(out);
+        });
+        runner.run("bcd_column_writer", digits, [&](size_t n) {
+            std::ostringstream out;
+            {
+                BCDTextWriter writer(out);
+                for (size_t i = 0; i < n; i++) {
+                    writer.write(a[i % rows]);
+                }
+            }
+            keep(out);
+        });
+        runner.run("bcd_std_sort", digits, [&](size_t n) {
+            for (size_t done = 0; done < n; done += rows) {
+                std::vector<BCD> column(a.begin(), a.begin() + std::min(rows, n - done));
+                std::sort(column.begin(), column.end());
+                keep(column);
+            }
+        });
+        runner.run("bcd_radix_sort", digits, [&](size_t n) {
+            for (size_t done = 0; done < n; done += rows) {
+                std::vector<BCD> column(a.begin(), a.begin() + std::min(rows, n - done));
+                BCD::sort(column.data(), column.size());
+                keep(column);
+            }
+        });
+        runner.run("bcd_hash_set", digits, [&](size_t n) {
+            for (size_t done = 0; done < n; done += rows) {
+                std::unordered_set<BCD> distinct(a.begin(), a.begin() + std::min(rows, n - done));
+                keep(distinct);
+            }
+        });
+    }
+}
+
+// Строка RPN из operations операций. Правый операнд каждой бинарной операции -
+// свежая константа от 1 до 9, поэтому деления на ноль нет. Смесь arith -
+// четыре действия, mixed - ещё sin, cos, atan2 и median
+std::string randomExpression(std::mt19937_64& rng, int operations, bool mixed) {
+    static const char* arith[] = {"+", "-", "*", "/"};
+    static const char* unary[] = {"sin", "cos"};
+    std::string line = std::to_string(1 + rng() % 9) + "." + std::to_string(rng() % 100);
+    for (int i = 0; i < operations; i++) {
+        int kind = mixed ? static_cast<int>(rng() % 8) : static_cast<int>(rng() % 4);
+        if (kind < 4) {
+            line += " " + std::to_string(1 + rng() % 9) + "." + std::to_string(rng() % 100) + " " + arith[kind];
+        } else if (kind < 6) {
+            line += std::string(" ") + unary[kind - 4];
+        } else if (kind == 6) {
+            line += " " + std::to_string(1 + rng() % 9) + " atan2";
+        } else {
+            line += " " + std::to_string(rng() % 9) + " " + std::to_string(rng() % 9) + " median";
+        }
+    }
+    return line;
+}
+
+void benchmarkCalculator(BenchmarkRunner& runner) {
+    std::mt19937_64 rng(7);
+    for (bool mixed : {false, true}) {
+        std::string mix = mixed ? "mixed" : "arith";
+        for (int operations : {4, 16, 64, 256}) {
+            // Набор разных строк одной длины, чтобы не мерить одну и ту же ветку
+            std::vector<std::string> lines;
+            for (int i = 0; i < 64; i++) {
+                lines.push_back(randomExpression(rng, operations, mixed));
+            }
+            std::vector<Program> programs;
+            for (const std::string& line : lines) {
+                programs.push_back(Program::compile(line));
+            }
+            Program program;
+            Calculator calc;
+            
+            runner.run("rpn_compile_" + mix, operations, [&](size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    program.assign(lines[i % lines.size()]);
+                    keep(program);
+                }
+            });
+            runner.run("rpn_evaluate_" + mix, operations, [&](size_t n) {
+                double sum = 0;
+                for (size_t i = 0; i < n; i++) sum += calc.evaluate(programs[i % programs.size()]);
+                keep(sum);
+            });
+            runner.run("rpn_line_" + mix, operations, [&](size_t n) {
+                double sum = 0;
+                for (size_t i = 0; i < n; i++) {
+                    program.assign(lines[i % lines.size()]);
+                    sum += calc.evaluate(program);
+                }
+                keep(sum);
+            });
+            std::vector<Program> optimized = programs;
+            for (Program& p : optimized) {
+                p.optimize();
+            }
+            runner.run("rpn_evaluate_optimized_" + mix, operations, [&](size_t n) {
+                double sum = 0;
+                for (size_t i = 0; i < n; i++) sum += calc.evaluate(optimized[i % optimized.size()]);
+                keep(sum);
+            });
+            // Пооперационный интерфейс: разбор токенов по пробелам на каждой строке
+            runner.run("rpn_tokens_" + mix, operations, [&](size_t n) {
+                double sum = 0;
+                for (size_t i = 0; i < n; i++) {
+                    std::istringstream tokens(lines[i % lines.size()]);
+                    std::string token;
+                    while (tokens >> token) {
+                        if (token == "+") calc.plus();
+                        else if (token == "-") calc.minus();
+                        else if (token == "*") calc.mult();
+                        else if (token == "/") calc.div();
+                        else if (token == "sin") calc.sin();
+                        else if (token == "cos") calc.cos();
+                        else if (token == "atan2") calc.atan2();
+                        else if (token == "median") calc.median();
+                        else calc.push(std::stod(token));
+                    }
+                    sum += calc.pop();
+                }
+                keep(sum);
+            });
+            if (!mixed) {
+                BasicCalculator<BCD> decimal(Arithmetic<BCD>(50));
+                std::vector<BasicProgram<BCD>> decimal_programs;
+                for (const std::string& line : lines) {
+                    decimal_programs.push_back(BasicProgram<BCD>::compile(line, {}, decimal.arithmetic()));
+                }
+                runner.run("rpn_evaluate_bcd50_" + mix, operations, [&](size_t n) {
+                    for (size_t i = 0; i < n; i++) keep(decimal.evaluate(decimal_programs[i % decimal_programs.size()]));
+                });
+            }
+        }
+    }
+    
+    // Столбцовое вычисление: параметр - число строк, время - на строку.
+    // rpn_column_row - только операции с векторными ядрами (+ - * / sqrt);
+    // rpn_column_std_fn_row - sin, log и pow, которые считаются std:: поэлементно
+    std::vector<std::string> names = {"x", "y"};
+    Program program = Program::compile("x y + x y - * x / y sqrt +", names);
+    size_t rows = 1 << 16;
+    std::vector<double> x(rows), y(rows), out(rows);
+    std::vector<RowError> errors(rows);
+    for (size_t i = 0; i < rows; i++) {
+        x[i] = 1 + rng() % 1000;
+        y[i] = 1 + rng() % 1000;
+    }
+    const double* inputs[] = {x.data(), y.data()};
+    ColumnEvaluator columns;
+    Calculator calc;
+    runner.run("rpn_column_row", static_cast<long long>(rows), [&](size_t n) {
+        for (size_t done = 0; done < n; done += rows) {
+            columns.evaluate(program, inputs, std::min(rows, n - done), out.data(), errors.data());
+        }
+        keep(out);
+    });
+    Program functions = Program::compile("x sin y log * x 0.5 pow +", names);
+    runner.run("rpn_column_std_fn_row", static_cast<long long>(rows), [&](size_t n) {
+        for (size_t done = 0; done < n; done += rows) {
+            columns.evaluate(functions, inputs, std::min(rows, n - done), out.data(), errors.data());
+        }
+        keep(out);
+    });
+    runner.run("rpn_scalar_row", static_cast<long long>(rows), [&](size_t n) {
+        double sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            double values[] = {x[i % rows], y[i % rows]};
+            sum += calc.evaluate(program, values);
+        }
+        keep(sum);
+    });
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view arg = argv[i];
+        if (arg == "--filter") {
+            options.filter = argv[i + 1];
+        } else if (arg == "--min-time") {
+            options.min_time = std::atof(argv[i + 1]);
+        } else if (arg == "--max-digits") {
+            options.max_digits = std::atoi(argv[i + 1]);
+        }
+    }
+    BenchmarkRunner runner(options);
+    benchmarkBCD(runner, options);
+    benchmarkColumns(runner);
+    benchmarkCalculator(runner);
+    return 0;
+}